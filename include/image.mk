@@ -75,26 +75,42 @@ endif
 JFFS2OPTS += $(MKFS_DEVTABLE_OPT)
 
 SQUASHFS_BLOCKSIZE := $(CONFIG_TARGET_SQUASHFS_BLOCK_SIZE)k
-SQUASHFSOPT := -b $(SQUASHFS_BLOCKSIZE)
-SQUASHFSOPT += -xattrs -p '/dev d 755 0 0' -p '/dev/console c 600 0 0 5 1'
+SQUASHFSOPT_COMMON := -xattrs -p '/dev d 755 0 0' -p '/dev/console c 600 0 0 5 1'
+SQUASHFSOPT := -b $(SQUASHFS_BLOCKSIZE) $(SQUASHFSOPT_COMMON)
+SQUASHFS_BOOT_ORDER := $(call qstrip,$(CONFIG_TARGET_SQUASHFS_BOOT_ORDER))
+ifneq ($(SQUASHFS_BOOT_ORDER),)
+  SQUASHFS_BOOT_ORDER := $(abspath $(if $(filter /%,$(SQUASHFS_BOOT_ORDER)),,$(TOPDIR)/)$(SQUASHFS_BOOT_ORDER))
+endif
 SQUASHFSCOMP := gzip
 LZMA_XZ_OPTIONS := -Xpreset 9 -Xe -Xlc 0 -Xlp 2 -Xpb 2
+ifneq ($(filter arm x86 powerpc sparc,$(LINUX_KARCH)),)
+  BCJ_FILTER:=-Xbcj $(LINUX_KARCH)
+endif
+ZSTD_OPTIONS := -Xcompression-level 22
+
+SQUASHFSCOMP-gzip := gzip
+SQUASHFSCOMP-xz := xz $(LZMA_XZ_OPTIONS) $(BCJ_FILTER)
+SQUASHFSCOMP-lz4 := lz4
+SQUASHFSCOMP-zstd := zstd $(ZSTD_OPTIONS)
+
 ifeq ($(CONFIG_SQUASHFS_XZ),y)
-  ifneq ($(filter arm x86 powerpc sparc,$(LINUX_KARCH)),)
-    BCJ_FILTER:=-Xbcj $(LINUX_KARCH)
-  endif
-  SQUASHFSCOMP := xz $(LZMA_XZ_OPTIONS) $(BCJ_FILTER)
+  SQUASHFSCOMP := $(SQUASHFSCOMP-xz)
 endif
 
 ifeq ($(CONFIG_SQUASHFS_LZ4),y)
-  SQUASHFSCOMP := lz4
+  SQUASHFSCOMP := $(SQUASHFSCOMP-lz4)
 endif
 
 ifeq ($(CONFIG_SQUASHFS_ZSTD),y)
-  ZSTD_OPTIONS := -Xcompression-level 22
-  SQUASHFSCOMP := zstd $(ZSTD_OPTIONS)
+  SQUASHFSCOMP := $(SQUASHFSCOMP-zstd)
 endif
 
+# Settings built by "make target/linux/benchmark", see scripts/rootfs-benchmark.sh
+BENCHMARK_SQUASHFS_COMP ?= gzip xz lz4 zstd
+BENCHMARK_SQUASHFS_BLOCKSIZE ?= 64k 128k 256k 1024k
+BENCHMARK_JFFS2_BLOCKSIZE ?= 64k 128k 256k
+BENCHMARK_DIR := $(BIN_DIR)/rootfs-benchmark
+
 JFFS2_BLOCKSIZE ?= 64k 128k
 
 fs-types-$(CONFIG_TARGET_ROOTFS_SQUASHFS) += squashfs
@@ -238,10 +254,27 @@ endef
 $(eval $(foreach S,$(JFFS2_BLOCKSIZE),$(call Image/mkfs/jffs2/template,$(S))))
 $(eval $(foreach S,$(NAND_BLOCKSIZE),$(call Image/mkfs/jffs2-nand/template,$(S))))
 
+define Image/benchmark/squashfs
+	$(STAGING_DIR_HOST)/bin/mksquashfs4 $(TARGET_DIR) \
+		$(BENCHMARK_DIR)/root.squashfs-$(1)-$(2) \
+		-nopad -noappend -root-owned -quiet -no-progress \
+		-comp $(SQUASHFSCOMP-$(1)) -b $(2) $(SQUASHFSOPT_COMMON)
+endef
+
+define Image/benchmark/jffs2
+	$(STAGING_DIR_HOST)/bin/mkfs.jffs2 $(JFFS2OPTS) \
+		-e $(patsubst %k,%KiB,$(1)) \
+		-o $(BENCHMARK_DIR)/root.jffs2-$(1) -d $(TARGET_DIR) \
+		2>&1 1>/dev/null | awk '/^.+$$$$/'
+endef
+
 define Image/mkfs/squashfs-common
+	$(if $(SQUASHFS_BOOT_ORDER),$(SCRIPT_DIR)/squashfs-sort-file.sh \
+		$(SQUASHFS_BOOT_ORDER) $(call mkfs_target_dir,$(1)) > $@.sort && ) \
 	$(STAGING_DIR_HOST)/bin/mksquashfs4 $(call mkfs_target_dir,$(1)) $@ \
 		-nopad -noappend $$([ "$$in_fakeroot" = "y" ] || echo -root-owned) \
 		-comp $(SQUASHFSCOMP) $(SQUASHFSOPT) \
+		$(if $(SQUASHFS_BOOT_ORDER),-sort $@.sort) \
 		-processors 1
 endef
 
@@ -963,7 +996,7 @@ define BuildImage
   image_prepare:
 
   ifeq ($(IB),)
-    .PHONY: download prepare compile clean image_prepare kernel_prepare install install-images
+    .PHONY: download prepare compile clean image_prepare kernel_prepare install install-images benchmark
     compile:
 		$(call Build/Compile)
 
@@ -997,4 +1030,16 @@ define BuildImage
   install: install-images
 	$(call Image/Manifest)
 
+  benchmark: image_prepare
+	rm -rf $(BENCHMARK_DIR)
+	mkdir -p $(BENCHMARK_DIR)
+	$(foreach comp,$(BENCHMARK_SQUASHFS_COMP),$(foreach bs,$(BENCHMARK_SQUASHFS_BLOCKSIZE),
+		$(call Image/benchmark/squashfs,$(comp),$(bs))
+	))
+	$(foreach bs,$(BENCHMARK_JFFS2_BLOCKSIZE),
+		$(call Image/benchmark/jffs2,$(bs))
+	)
+	$(CP) $(SCRIPT_DIR)/rootfs-benchmark.sh $(BENCHMARK_DIR)/
+	$(SCRIPT_DIR)/rootfs-benchmark.sh sizes $(BENCHMARK_DIR) | tee $(BENCHMARK_DIR)/sizes.txt
+
 endef
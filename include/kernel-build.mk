@@ -172,6 +172,9 @@ define BuildKernel
   install: $(LINUX_DIR)/.image
 	+$(MAKE) -C image compile install TARGET_BUILD=
 
+  benchmark: $(LINUX_DIR)/.image
+	+$(MAKE) -C image compile benchmark TARGET_BUILD=
+
   clean: FORCE
 	rm -rf $(KERNEL_BUILD_DIR)
 
@@ -0,0 +1,40 @@
+# Print the .mk files included by the scanned Makefiles as additional scan
+# dependencies, so they are part of the DUMP cache key. Relative includes are
+# resolved against the package directory like make does, includes using any
+# variable other than TOPDIR and INCLUDE_DIR are skipped. rules.mk and
+# include/*.mk are covered by SCAN_MK_HASH in scan.mk.
+
+function includes(pkg, file,    line, words, n, i, path) {
+	while ((getline line < file) > 0) {
+		if (line !~ /^[ \t]*-?s?include[ \t]/)
+			continue
+		sub(/^[ \t]*-?s?include[ \t]+/, "", line)
+		sub(/[ \t]*#.*/, "", line)
+		n = split(line, words, /[ \t]+/)
+		for (i = 1; i <= n; i++) {
+			path = words[i]
+			if (path ~ /^\//)
+				continue
+			if (sub(/^\$\(INCLUDE_DIR\)\//, "include/", path) == 0 &&
+			    sub(/^\$\(TOPDIR\)\//, "", path) == 0)
+				path = pkg "/" path
+			if (path !~ /\.mk$/ || path ~ /\$/ || path in seen)
+				continue
+			seen[path] = 1
+			if (path == "rules.mk" || path ~ /^include\/[^\/]*\.mk$/)
+				continue
+			deps = deps " $(TOPDIR)/" path
+			includes(pkg, path)
+		}
+	}
+	close(file)
+}
+
+{
+	pkg = dir "/" $0
+	deps = ""
+	split("", seen)
+	includes(pkg, pkg "/Makefile")
+	if (deps != "")
+		print "DEPS_" pkg "/Makefile +=" deps
+}
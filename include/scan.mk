@@ -11,6 +11,14 @@ TARGET_STAMP:=$(TMP_DIR)/info/.files-$(SCAN_TARGET).stamp
 FILELIST:=$(TMP_DIR)/info/.files-$(SCAN_TARGET)-$(SCAN_COOKIE)
 OVERRIDELIST:=$(TMP_DIR)/info/.overrides-$(SCAN_TARGET)-$(SCAN_COOKIE)
 
+# DUMP output by hash of the Makefile, the .mk files it includes and its scan
+# dependencies, shared by all scans, so a Makefile that only got a new mtime
+# is not evaluated again
+SCAN_CACHE ?= $(TOPDIR)/tmp/info/.scan-cache
+
+# rules.mk and include/*.mk are read by every DUMP, hash them once per scan
+SCAN_MK_HASH := $(shell cat $(TOPDIR)/rules.mk $(TOPDIR)/include/*.mk | $(MKHASH) md5)
+
 export PATH:=$(TOPDIR)/staging_dir/host/bin:$(PATH)
 
 define feedname
@@ -46,15 +54,24 @@ define PackageDir
   $(TMP_DIR)/.$(SCAN_TARGET): $(TMP_DIR)/info/.$(SCAN_TARGET)-$(1)
   $(TMP_DIR)/info/.$(SCAN_TARGET)-$(1): $(SCAN_DIR)/$(2)/Makefile $(foreach DEP,$(DEPS_$(SCAN_DIR)/$(2)/Makefile) $(SCAN_DEPS),$(wildcard $(if $(filter /%,$(DEP)),$(DEP),$(SCAN_DIR)/$(2)/$(DEP))))
 	{ \
-		$$(call progress,Collecting $(SCAN_NAME) info: $(SCAN_DIR)/$(2)) \
 		echo Source-Makefile: $(SCAN_DIR)/$(2)/Makefile; \
 		$(if $(3),echo Override: $(3),true); \
-		$(NO_TRACE_MAKE) --no-print-dir -r DUMP=1 FEED="$(call feedname,$(2))" -C $(SCAN_DIR)/$(2) $(SCAN_MAKEOPTS) 2>/dev/null || { \
+		hash=$$$$( { echo "$(SCAN_DIR)/$(2) $(call feedname,$(2)) $(SCAN_MAKEOPTS) $(SCAN_MK_HASH) $$^"; cat $$^; } | $(MKHASH) md5 ); \
+		if [ -f "$(SCAN_CACHE)/$$$$hash" ]; then \
+			touch "$(SCAN_CACHE)/$$$$hash"; \
+			cat "$(SCAN_CACHE)/$$$$hash"; \
+		elif $$(call progress,Collecting $(SCAN_NAME) info: $(SCAN_DIR)/$(2)) \
+			$(NO_TRACE_MAKE) --no-print-dir -r DUMP=1 FEED="$(call feedname,$(2))" -C $(SCAN_DIR)/$(2) $(SCAN_MAKEOPTS) > $$@.dump 2>/dev/null; then \
+			cat $$@.dump; \
+			mkdir -p "$(SCAN_CACHE)"; \
+			mv $$@.dump "$(SCAN_CACHE)/$$$$hash"; \
+		else \
+			rm -f $$@.dump; \
 			mkdir -p "$(TOPDIR)/logs/$(SCAN_DIR)/$(2)"; \
 			$(NO_TRACE_MAKE) --no-print-dir -r DUMP=1 FEED="$(call feedname,$(2))" -C $(SCAN_DIR)/$(2) $(SCAN_MAKEOPTS) > $(TOPDIR)/logs/$(SCAN_DIR)/$(2)/dump.txt 2>&1; \
 			$$(call progress,ERROR: please fix $(SCAN_DIR)/$(2)/Makefile - see logs/$(SCAN_DIR)/$(2)/dump.txt for details\n) \
 			rm -f $$@; \
-		}; \
+		fi; \
 		echo; \
 	} > $$@.tmp
 	mv $$@.tmp $$@
@@ -77,6 +94,7 @@ $(FILELIST): $(OVERRIDELIST)
 $(TMP_DIR)/info/.files-$(SCAN_TARGET).mk: $(FILELIST)
 	( \
 		cat $< | awk '{print "$(SCAN_DIR)/" $$0 "/Makefile" }' | xargs grep -HE '^ *SCAN_DEPS *= *' | awk -F: '{ gsub(/^.*DEPS *= */, "", $$2); print "DEPS_" $$1 "=" $$2 }'; \
+		awk -v dir="$(SCAN_DIR)" -f include/scan-includes.awk < $<; \
 		awk -F/ -v deps="$$DEPS" -v of="$(OVERRIDELIST)" ' \
 		BEGIN { \
 			while (getline < (of)) \
@@ -112,9 +130,9 @@ $(TARGET_STAMP)::
 $(TMP_DIR)/.$(SCAN_TARGET): $(TARGET_STAMP)
 	$(call progress,Collecting $(SCAN_NAME) info: merging...)
 	-cat $(FILELIST) | awk '{gsub(/\//, "_", $$0);print "$(TMP_DIR)/info/.$(SCAN_TARGET)-" $$0}' | xargs cat > $@ 2>/dev/null
+	-find "$(SCAN_CACHE)" -type f -mtime +30 -exec rm -f {} + 2>/dev/null
 	$(call progress,Collecting $(SCAN_NAME) info: done)
 	echo
 
 FORCE:
 .PHONY: FORCE
-.NOTPARALLEL:
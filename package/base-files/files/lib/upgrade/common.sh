@@ -129,6 +129,7 @@ identify_magic_long() {
 		"d00dfeed") echo "fit" ;;
 		"4349"*) echo "combined" ;;
 		"1f8b"*) echo "gzip" ;;
+		"4d444c54") echo "delta" ;;
 		*) echo "unknown $magic" ;;
 	esac
 }
@@ -309,6 +310,104 @@ get_partitions() { # <device> <filename>
 	fi
 }
 
+# Delta images (see scripts/sysupgrade-delta.py) hold the new contents of
+# partitions as changes to the installed firmware and are applied with
+# mtd-delta. Platforms enable them by setting DELTA_UPGRADE to "mtd" for
+# images written by default_do_upgrade() or to "nand" for nand_do_upgrade().
+# No platform in this tree sets it yet: ipq40xx flashes the sections of a FIT
+# image to the failsafe partitions with platform_do_upgrade_ipq(), which has
+# no delta mode, so delta images are rejected there.
+delta_is_image() {
+	[ "$(identify_magic_long "$(get_magic_long "$1" cat)")" = "delta" ]
+}
+
+# Print the device holding the current contents of a delta image section
+delta_section_device() {
+	local index
+
+	case "$DELTA_UPGRADE" in
+		mtd)
+			index="$(find_mtd_index "$1")"
+			[ -n "$index" ] && echo "/dev/mtd$index"
+			;;
+		nand)
+			nand_delta_device "$1"
+			;;
+	esac
+}
+
+delta_hash_matches() { # <device> <size> <sha256>
+	[ "$(head -c "$2" "$1" | sha256sum | cut -d' ' -f1)" = "$3" ]
+}
+
+# Check that every section of a delta image applies to the installed
+# firmware and produces the expected contents, before anything is erased.
+# The sections are listed in /tmp/sysupgrade.delta as
+# "<name> <old size> <old sha256> <new size> <new sha256>".
+delta_check_image() {
+	local name old_size old_sha256 new_size new_sha256 dev
+
+	[ -n "$DELTA_UPGRADE" ] || {
+		echo "Delta images are not supported on this device"
+		return 1
+	}
+
+	mtd-delta info "$1" > /tmp/sysupgrade.delta || {
+		echo "Invalid delta image"
+		return 1
+	}
+
+	while read name old_size old_sha256 new_size new_sha256; do
+		dev="$(delta_section_device "$name")"
+
+		[ "$old_size" -eq 0 ] || {
+			[ -n "$dev" ] && delta_hash_matches "$dev" "$old_size" "$old_sha256"
+		} || {
+			echo "Delta image does not match the installed firmware ($name), a full image is needed"
+			return 1
+		}
+
+		# mtd-delta checks the new contents against their hash
+		mtd-delta apply "$1" "$name" $dev > /dev/null || {
+			echo "Delta image is corrupt ($name)"
+			return 1
+		}
+	done < /tmp/sysupgrade.delta
+
+	return 0
+}
+
+# Patch MTD partitions in place with a delta image
+delta_do_upgrade() {
+	local delta="$1"
+	local name old_size old_sha256 new_size new_sha256 dev
+	local failed="/tmp/sysupgrade.delta.failed"
+
+	delta_check_image "$delta" || exit 1
+	rm -f "$failed"
+
+	while read name old_size old_sha256 new_size new_sha256; do
+		dev="$(delta_section_device "$name")"
+		v "Patching $name..."
+
+		if [ -n "$UPGRADE_BACKUP" ]; then
+			{ mtd-delta apply -i "$delta" "$name" "$dev" || touch "$failed"; } | \
+				mtd $MTD_ARGS $MTD_CONFIG_ARGS -j "$UPGRADE_BACKUP" write - "$name"
+		else
+			{ mtd-delta apply -i "$delta" "$name" "$dev" || touch "$failed"; } | \
+				mtd $MTD_ARGS write - "$name"
+		fi
+		[ $? -ne 0 -o -f "$failed" ] && exit 1
+
+		# The config backup replaces the end of the image, so only the
+		# plain image can be read back
+		[ -n "$UPGRADE_BACKUP" ] || delta_hash_matches "$dev" "$new_size" "$new_sha256" || {
+			v "Verification of $name failed"
+			exit 1
+		}
+	done < /tmp/sysupgrade.delta
+}
+
 # Flash firmware to MTD partition
 #
 # $(1): path to image
@@ -316,6 +415,10 @@ get_partitions() { # <device> <filename>
 default_do_upgrade() {
 	sync
 	echo 3 > /proc/sys/vm/drop_caches
+	if delta_is_image "$1"; then
+		delta_do_upgrade "$1"
+		return
+	fi
 	if [ -n "$UPGRADE_BACKUP" ]; then
 		get_image "$1" "$2" | mtd $MTD_ARGS $MTD_CONFIG_ARGS -j "$UPGRADE_BACKUP" write - "${PART_NAME:-image}"
 	else
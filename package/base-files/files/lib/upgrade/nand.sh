@@ -80,6 +80,9 @@ identify_magic() {
 		"4349"*)
 			echo "combined"
 			;;
+		"4d444c54")
+			echo "delta"
+			;;
 		*)
 			echo "unknown $magic"
 			;;
@@ -276,6 +279,163 @@ nand_upgrade_tar() {
 	nand_do_upgrade_success
 }
 
+# Print the device holding the current contents of a delta image section:
+# "kernel" is the kernel MTD partition or UBI volume, "root" the rootfs volume
+nand_delta_device() {
+	local section="$1"
+	local ubidev="$( nand_find_ubi "$CI_UBIPART" )"
+	local mtdnum vol
+
+	case "$section" in
+		kernel)
+			mtdnum="$( find_mtd_index "$CI_KERNPART" )"
+			[ "$mtdnum" ] && {
+				echo "/dev/mtd$mtdnum"
+				return 0
+			}
+			vol="$CI_KERNPART"
+			;;
+		root)
+			vol="$CI_ROOTPART"
+			;;
+		*)
+			return 1
+			;;
+	esac
+
+	[ "$ubidev" ] || return 1
+	vol="$( nand_find_volume $ubidev $vol )"
+	[ "$vol" ] && echo "/dev/$vol"
+}
+
+# Undo a delta upgrade that failed before its volumes were renamed into
+# place: drop the new volumes and give the old firmware back its
+# rootfs_data, with the saved config
+nand_delta_abort() {
+	local ubidev="$1"
+	local conf_tar="/tmp/sysupgrade.tgz"
+	local vol
+
+	for vol in $CI_KERNPART $CI_ROOTPART; do
+		[ "$( nand_find_volume $ubidev ${vol}_delta )" ] && \
+			ubirmvol /dev/$ubidev -N ${vol}_delta
+	done
+
+	[ "$( nand_find_volume $ubidev rootfs_data )" ] || {
+		if ubimkvol /dev/$ubidev -N rootfs_data -m; then
+			[ -f "$conf_tar" ] && nand_restore_config "$conf_tar"
+		else
+			echo "cannot initialize rootfs_data volume"
+		fi
+	}
+
+	return 1
+}
+
+# Patch the kernel and rootfs with a delta image. The new UBI volumes are
+# written next to the old ones, checked, and only then renamed into place.
+# There is no full image to fall back to, so a failure before the rename
+# leaves the installed firmware in place and the device boots it again.
+nand_upgrade_delta() {
+	local delta_file="$1"
+	local ubidev="$( nand_find_ubi "$CI_UBIPART" )"
+	local failed="/tmp/sysupgrade.delta.failed"
+	local name old_size old_sha256 new_size new_sha256 dev vol new_vol
+	local renames="" old_vols=""
+
+	if [ ! "$ubidev" ]; then
+		echo "cannot find ubi device $CI_UBIPART"
+		return 1
+	fi
+
+	delta_check_image "$delta_file" || return 1
+	rm -f "$failed"
+
+	# make room for the new volumes, the config is restored afterwards
+	local data_ubivol="$( nand_find_volume $ubidev rootfs_data )"
+	[ "$data_ubivol" ] && ubirmvol /dev/$ubidev -N rootfs_data || true
+
+	while read name old_size old_sha256 new_size new_sha256; do
+		dev="$( nand_delta_device "$name" )"
+		case "$name" in
+			kernel) vol="$CI_KERNPART";;
+			root) vol="$CI_ROOTPART";;
+			*) continue;;
+		esac
+
+		# a kernel in its own MTD partition is written after the volumes
+		case "$dev" in
+			/dev/mtd*) continue;;
+		esac
+
+		ubimkvol /dev/$ubidev -N ${vol}_delta -s $new_size || {
+			echo "cannot create $vol volume"
+			nand_delta_abort $ubidev
+			return 1
+		}
+		new_vol="$( nand_find_volume $ubidev ${vol}_delta )"
+		{ mtd-delta apply "$delta_file" "$name" "$dev" || touch "$failed"; } | \
+			ubiupdatevol /dev/$new_vol -s $new_size -
+		if [ $? -ne 0 -o -f "$failed" ] || ! delta_hash_matches "/dev/$new_vol" "$new_size" "$new_sha256"; then
+			echo "cannot write $vol volume"
+			nand_delta_abort $ubidev
+			return 1
+		fi
+
+		if [ "$dev" ]; then
+			renames="$renames $vol ${vol}_old"
+			old_vols="$old_vols ${vol}_old"
+		fi
+		renames="$renames ${vol}_delta $vol"
+	done < /tmp/sysupgrade.delta
+
+	# the kernel partition is patched in place, a failure here cannot be
+	# undone but the volumes still are
+	while read name old_size old_sha256 new_size new_sha256; do
+		dev="$( nand_delta_device "$name" )"
+		case "$dev" in
+			/dev/mtd*) ;;
+			*) continue;;
+		esac
+
+		{ mtd-delta apply -i "$delta_file" "$name" "$dev" || touch "$failed"; } | \
+			mtd write - "$CI_KERNPART"
+		if [ $? -ne 0 -o -f "$failed" ]; then
+			echo "cannot write $CI_KERNPART partition"
+			nand_delta_abort $ubidev
+			return 1
+		fi
+	done < /tmp/sysupgrade.delta
+
+	# remove ubiblock device of rootfs
+	local root_ubivol="$( nand_find_volume $ubidev $CI_ROOTPART )"
+	local root_ubiblk="ubiblock${root_ubivol:3}"
+	if [ "$root_ubivol" -a -e "/dev/$root_ubiblk" ]; then
+		echo "removing $root_ubiblk"
+		if ! ubiblock -r /dev/$root_ubivol; then
+			echo "cannot remove $root_ubiblk"
+			nand_delta_abort $ubidev
+			return 1
+		fi
+	fi
+
+	if [ "$renames" ] && ! ubirename /dev/$ubidev $renames; then
+		echo "cannot rename the new volumes"
+		nand_delta_abort $ubidev
+		return 1
+	fi
+	for vol in $old_vols; do
+		ubirmvol /dev/$ubidev -N $vol
+	done
+
+	if ! ubimkvol /dev/$ubidev -N rootfs_data -m; then
+		echo "cannot initialize rootfs_data volume"
+		return 1
+	fi
+
+	nand_do_upgrade_success
+}
+
 # Recognize type of passed file and start the upgrade process
 nand_do_upgrade() {
 	local file_type=$(identify $1)
@@ -285,6 +445,7 @@ nand_do_upgrade() {
 	case "$file_type" in
 		"ubi")		nand_upgrade_ubinized $1;;
 		"ubifs")	nand_upgrade_ubifs $1;;
+		"delta")	nand_upgrade_delta $1;;
 		*)		nand_upgrade_tar $1;;
 	esac
 }
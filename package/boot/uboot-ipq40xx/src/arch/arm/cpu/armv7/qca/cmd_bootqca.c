@@ -518,6 +518,8 @@ static int do_boot_signedimg(cmd_tbl_t *cmdtp, int flag, int argc, char *const a
 	request = CONFIG_SYS_LOAD_ADDR;
 	kernel_img_info.kernel_load_addr = request;
 
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_START, "kernel_read_start");
+
 	if (ipq_fs_on_nand) {
 		if (sfi->rootfs.offset == 0xBAD0FF5E) {
 			sfi->rootfs.offset = 0;
@@ -589,6 +591,8 @@ static int do_boot_signedimg(cmd_tbl_t *cmdtp, int flag, int argc, char *const a
 		kernel_img_info.kernel_load_size =  sfi->hlos.size;
 	}
 
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_STOP, "kernel_read_done");
+
 	request += sizeof(mbn_header_t);
 
 	ret = scm_call(SCM_SVC_BOOT, KERNEL_AUTH_CMD, &kernel_img_info,
@@ -599,6 +603,8 @@ static int do_boot_signedimg(cmd_tbl_t *cmdtp, int flag, int argc, char *const a
 		BUG();
 	}
 
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "kernel_auth_done");
+
 	dcache_enable();
 
 	ret = config_select(request, gboard_param->dtb_config_name,
@@ -758,6 +764,8 @@ static int do_boot_unsignedimg(cmd_tbl_t *cmdtp, int flag, int argc, char *const
 		return -1;
 	}
 
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_START, "kernel_read_start");
+
 	if (run_command(runcmd, 0) != CMD_RET_SUCCESS) {
 #ifdef CONFIG_QCA_MMC
 		mmc_initialize(gd->bd);
@@ -765,6 +773,8 @@ static int do_boot_unsignedimg(cmd_tbl_t *cmdtp, int flag, int argc, char *const
 		return CMD_RET_FAILURE;
 	}
 
+	bootstage_mark_name(BOOTSTAGE_KERNELREAD_STOP, "kernel_read_done");
+
 	dcache_enable();
 
 	ret = genimg_get_format((void *)CONFIG_SYS_LOAD_ADDR);
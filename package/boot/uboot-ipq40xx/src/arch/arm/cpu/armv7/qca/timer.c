@@ -140,3 +140,14 @@ ulong get_timer_masked(void)
 
 	return (ulong)timestamp;
 }
+
+/**
+ * timer_get_boot_us - returns time since reset in microseconds
+ *
+ * The global counter is already running when we are started, so unlike
+ * the generic version this also covers the time spent in the SBLs.
+ */
+ulong timer_get_boot_us(void)
+{
+	return (ulong)(read_counter() / GPT_FREQ);
+}
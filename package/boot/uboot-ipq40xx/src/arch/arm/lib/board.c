@@ -673,6 +673,7 @@ void board_init_r(gd_t *id, ulong dest_addr)
 	load_addr = getenv_ulong("loadaddr", 16, load_addr);
 
 #ifdef CONFIG_BOARD_LATE_INIT
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "board_late_init");
 	board_late_init();
 #endif
 
@@ -1228,6 +1228,8 @@ void ft_board_setup(void *blob, bd_t *bd)
 		{ NULL, 0, -1 },	/* Terminator */
 	};
 
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "ft_board_setup");
+
 	fdt_fixup_memory_banks(blob, &memory_start, &memory_size, 1);
 	ipq_fdt_fixup_version(blob);
 #ifndef CONFIG_QCA_APPSBL_DLOAD
@@ -1280,6 +1282,7 @@ void ft_board_setup(void *blob, bd_t *bd)
 	ipq40xx_set_ethmac_addr();
 	fdt_fixup_ethernet(blob);
 	ipq_fdt_fixup_usb_device_mode(blob);
+	bootstage_fdt_add_report(blob);
 
 #ifdef CONFIG_QCA_MMC
         board_mmc_deinit();
@@ -23,9 +23,8 @@
 
 /*
  * This module records the progress of boot and arbitrary commands, and
- * permits accurate timestamping of each.
- *
- * TBD: Pass timings to kernel in the FDT
+ * permits accurate timestamping of each. The timings can be passed to the
+ * kernel in a /bootstage node of the FDT.
  */
 
 #include <common.h>
@@ -157,6 +156,84 @@ void bootstage_report(void)
 		       next_id - BOOTSTAGE_ID_COUNT);
 }
 
+#ifdef CONFIG_OF_LIBFDT
+static const char *get_record_name(char *buf, int len,
+				   struct bootstage_record *rec)
+{
+	if (rec->name)
+		return rec->name;
+	else if (rec->id >= BOOTSTAGE_ID_USER)
+		snprintf(buf, len, "user_%d", rec->id - BOOTSTAGE_ID_USER);
+	else
+		snprintf(buf, len, "id=%d", rec->id);
+
+	return buf;
+}
+
+/*
+ * Add a /bootstage node with one numbered subnode per record, holding
+ * "name" and "mark" (microseconds since reset), in order of time. The
+ * record table itself is left unsorted as bootstage_report() may still
+ * run after this.
+ */
+int bootstage_fdt_add_report(void *blob)
+{
+	struct bootstage_record *rec, *next;
+	ulong prev_time = 0;
+	int prev_id = -1;
+	char buf[20];
+	int bootstage, node;
+	int id, i;
+
+	if (!blob)
+		return -1;
+
+	bootstage = fdt_path_offset(blob, "/bootstage");
+	if (bootstage >= 0)
+		fdt_del_node(blob, bootstage);
+
+	bootstage = fdt_add_subnode(blob, 0, "bootstage");
+	if (bootstage < 0)
+		goto err;
+
+	for (i = 0; ; i++) {
+		/* Record 0 is only a placeholder, see the initialiser */
+		next = NULL;
+		for (id = 1; id < BOOTSTAGE_ID_COUNT; id++) {
+			rec = &record[id];
+			if (!rec->time_us)
+				continue;
+			if (rec->time_us < prev_time ||
+			    (rec->time_us == prev_time && id <= prev_id))
+				continue;
+			if (!next || rec->time_us < next->time_us)
+				next = rec;
+		}
+		if (!next)
+			break;
+
+		prev_time = next->time_us;
+		prev_id = next - record;
+
+		sprintf(buf, "%d", i);
+		node = fdt_add_subnode(blob, bootstage, buf);
+		if (node < 0)
+			goto err;
+
+		if (fdt_setprop_string(blob, node, "name",
+				       get_record_name(buf, sizeof(buf), next)) ||
+		    fdt_setprop_cell(blob, node, "mark", next->time_us))
+			goto err;
+	}
+
+	return 0;
+
+err:
+	puts("bootstage: Failed to add to device tree\n");
+	return -1;
+}
+#endif /* CONFIG_OF_LIBFDT */
+
 ulong __timer_get_boot_us(void)
 {
 	static ulong base_time;
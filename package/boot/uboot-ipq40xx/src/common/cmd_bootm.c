@@ -615,6 +615,11 @@ int do_bootm(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	if (bootm_start(cmdtp, flag, argc, argv))
 		return 1;
 
+#ifdef CONFIG_FIT_HASH_CACHE
+	/* All images are verified, remember the ones that were new */
+	fit_hash_cache_commit();
+#endif
+
 	/*
 	 * We have reached the point of no return: we are going to
 	 * overwrite all exception vector code, so we cannot easily
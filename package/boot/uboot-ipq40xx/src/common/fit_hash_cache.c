@@ -0,0 +1,202 @@
+/*
+ * Remember FIT component images whose hashes were verified, so that an
+ * unchanged image is not hashed again on every boot.
+ *
+ * An image is identified by a fingerprint: CRC32 over the hash values
+ * stored in its hash nodes, its data size and all of its data. Every byte
+ * is still read and checked on a hit, so a corrupted image misses the
+ * cache and fails the full verification. What is saved is the slower
+ * SHA1 or MD5 hashing of images that did not change.
+ *
+ * Fingerprints of verified images are kept in the "fit_hashcache"
+ * environment variable, most recent first, and only while fast boot is
+ * enabled. The environment is written once after an image changed,
+ * before bootm goes past the point of no return.
+ */
+
+#include <common.h>
+#include <image.h>
+#include <libfdt.h>
+#include <u-boot/crc.h>
+
+#define HASH_CACHE_VAR		"fit_hashcache"
+#define HASH_CACHE_ENTRIES	4
+
+static uint32_t added[HASH_CACHE_ENTRIES];
+static int added_count;
+
+static int fit_hash_cache_enabled(void)
+{
+#ifdef CONFIG_FASTBOOT
+	return fastboot_enabled();
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Returns the fingerprint of an image, or 0 if it has no hash nodes
+ * and so nothing to skip.
+ */
+static uint32_t fit_hash_fingerprint(const void *fit, int image_noffset,
+				     const void *data, size_t size)
+{
+	uint8_t *value;
+	uint32_t crc = 0;
+	uint32_t be_size;
+	int value_len;
+	int noffset;
+	int ndepth;
+	int hashes = 0;
+
+	for (ndepth = 0, noffset = fdt_next_node(fit, image_noffset, &ndepth);
+	     (noffset >= 0) && (ndepth > 0);
+	     noffset = fdt_next_node(fit, noffset, &ndepth)) {
+		if (ndepth != 1 ||
+		    strncmp(fit_get_name(fit, noffset, NULL),
+			    FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+
+		if (fit_image_hash_get_value(fit, noffset, &value, &value_len))
+			return 0;
+
+		crc = crc32(crc, value, value_len);
+		hashes++;
+	}
+
+	if (!hashes)
+		return 0;
+
+	be_size = cpu_to_be32(size);
+	crc = crc32(crc, (const uchar *)&be_size, sizeof(be_size));
+	crc = crc32_wd(crc, data, size, CHUNKSZ_CRC32);
+
+	/* 0 means "no fingerprint" */
+	return crc ? crc : 1;
+}
+
+static int fit_hash_cache_find(const char *list, uint32_t fp)
+{
+	char *end;
+
+	while (list && *list) {
+		if (simple_strtoul(list, &end, 16) == fp && end != list)
+			return 1;
+		if (end == list)
+			break;
+		list = end;
+		while (*list == ' ')
+			list++;
+	}
+
+	return 0;
+}
+
+/**
+ * fit_hash_cache_lookup - check if an image was verified before
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @data: image data
+ * @size: image data length
+ *
+ * returns:
+ *     1, if the image is unchanged since its hashes were verified
+ *     0, otherwise
+ */
+int fit_hash_cache_lookup(const void *fit, int image_noffset,
+			  const void *data, size_t size)
+{
+	uint32_t fp;
+
+	if (!fit_hash_cache_enabled())
+		return 0;
+
+	fp = fit_hash_fingerprint(fit, image_noffset, data, size);
+
+	return fp && fit_hash_cache_find(getenv(HASH_CACHE_VAR), fp);
+}
+
+/**
+ * fit_hash_cache_add - remember an image whose hashes were verified
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @data: image data
+ * @size: image data length
+ *
+ * The image is only written to the environment by fit_hash_cache_commit().
+ */
+void fit_hash_cache_add(const void *fit, int image_noffset,
+			const void *data, size_t size)
+{
+	uint32_t fp;
+	int i;
+
+	if (!fit_hash_cache_enabled())
+		return;
+
+	fp = fit_hash_fingerprint(fit, image_noffset, data, size);
+	if (!fp)
+		return;
+
+	for (i = 0; i < added_count; i++)
+		if (added[i] == fp)
+			return;
+
+	if (added_count < HASH_CACHE_ENTRIES)
+		added[added_count++] = fp;
+}
+
+/**
+ * fit_hash_cache_commit - save images added since the last commit
+ *
+ * Called once all images of a boot are verified. Does nothing, and does
+ * not touch the flash, when every image was already known.
+ */
+void fit_hash_cache_commit(void)
+{
+	char buf[HASH_CACHE_ENTRIES * 9 + 1];
+	const char *old;
+	char *end;
+	uint32_t fp;
+	int count = 0;
+	int len = 0;
+	int dcache;
+	int i;
+
+	if (!added_count)
+		return;
+
+	for (i = 0; i < added_count; i++, count++)
+		len += sprintf(buf + len, "%s%08x", len ? " " : "", added[i]);
+
+	/* Keep the older entries that still fit, most recent first */
+	old = getenv(HASH_CACHE_VAR);
+	while (old && *old && count < HASH_CACHE_ENTRIES) {
+		fp = simple_strtoul(old, &end, 16);
+		if (end == old)
+			break;
+		old = end;
+		while (*old == ' ')
+			old++;
+
+		for (i = 0; i < added_count; i++)
+			if (added[i] == fp)
+				break;
+		if (i < added_count)
+			continue;
+
+		len += sprintf(buf + len, " %08x", fp);
+		count++;
+	}
+
+	added_count = 0;
+	setenv(HASH_CACHE_VAR, buf);
+
+	/* The flash drivers expect to be used with the data cache off */
+	dcache = dcache_status();
+	if (dcache)
+		dcache_disable();
+	saveenv();
+	if (dcache)
+		dcache_enable();
+}
@@ -2769,6 +2769,13 @@ int fit_image_check_hashes(const void *fit, int image_noffset)
 		return 0;
 	}
 
+#if defined(CONFIG_FIT_HASH_CACHE) && !defined(USE_HOSTCC)
+	if (fit_hash_cache_lookup(fit, image_noffset, data, size)) {
+		printf("cached ");
+		return 1;
+	}
+#endif
+
 	/* Process all hash subnodes of the component image node */
 	for (ndepth = 0, noffset = fdt_next_node(fit, image_noffset, &ndepth);
 	     (noffset >= 0) && (ndepth > 0);
@@ -2818,6 +2825,10 @@ int fit_image_check_hashes(const void *fit, int image_noffset)
 		}
 	}
 
+#if defined(CONFIG_FIT_HASH_CACHE) && !defined(USE_HOSTCC)
+	fit_hash_cache_add(fit, image_noffset, data, size);
+#endif
+
 	return 1;
 
 error:
@@ -279,6 +279,19 @@ int abortboot(int bootdelay)
 
 /****************************************************************************/
 
+#ifdef CONFIG_FASTBOOT
+/*
+ * Fast boot is enabled by setting "fastboot" to 1 or yes in the
+ * environment, "fastboot=0" or unset keeps the usual boot.
+ */
+int fastboot_enabled(void)
+{
+	char *s = getenv("fastboot");
+
+	return s && (*s == '1' || *s == 'y');
+}
+#endif
+
 void main_loop (void)
 {
 	unsigned char led_off = 0;
@@ -303,6 +316,8 @@ void main_loop (void)
 	char bcs_set[16];
 #endif /* CONFIG_BOOTCOUNT_LIMIT */
 
+	bootstage_mark_name(BOOTSTAGE_ID_MAIN_LOOP, "main_loop");
+
 #ifdef CONFIG_BOOTCOUNT_LIMIT
 	bootcount = bootcount_load();
 	bootcount++;
@@ -365,6 +380,12 @@ void main_loop (void)
 	s = getenv ("bootdelay");
 	bootdelay = s ? (int)simple_strtol(s, NULL, 10) : CONFIG_BOOTDELAY;
 
+#ifdef CONFIG_FASTBOOT
+	/* Only a key pressed before we got here stops a fast boot */
+	if (bootdelay > 0 && fastboot_enabled())
+		bootdelay = 0;
+#endif
+
 	debug ("### main_loop entered: bootdelay=%d\n\n", bootdelay);
 
 #if defined(CONFIG_MENU_SHOW)
@@ -27,6 +27,9 @@
 // debug
 //#define DEBUG_UIP
 
+// print one progress mark per this many bytes received
+#define PROGRESS_STEP			(64 * 1024)
+
 // html files
 extern const struct fsdata_file file_index_html;
 extern const struct fsdata_file file_404_html;
@@ -48,6 +51,7 @@ static int data_start_found = 0;
 static int small_file_flag = 0;
 
 static unsigned char post_packet_counter = 0;
+static unsigned int post_progress_bytes = 0;
 
 // 0x0D -> CR 0x0A -> LF
 static char eol[3] = { 0x0d, 0x0a, 0x00 };
@@ -67,16 +71,25 @@ int atoi(const char *s){
 }
 
 // print downloading progress
-static void httpd_download_progress(void){
-	static char led_animation_counter = 0;
+// printing a mark for every packet keeps the console busy for longer
+// than it takes to receive the packet, so only every PROGRESS_STEP bytes
+static void httpd_download_progress(unsigned int len){
+#ifdef CONFIG_SHIFT_REG
+		check_timer_led();
+#endif
+
+	post_progress_bytes += len;
+
+	if(post_progress_bytes < PROGRESS_STEP){
+		return;
+	}
+
+	post_progress_bytes -= PROGRESS_STEP;
+
 	if(post_packet_counter == 39){
 		puts("\n         ");
 		post_packet_counter = 0;
 	}
-	
-#ifdef CONFIG_SHIFT_REG
-		check_timer_led();
-#endif
 
 	puts("#");
 	post_packet_counter++;
@@ -98,6 +111,7 @@ static void httpd_state_reset(void){
 
 	data_start_found = 0;
 	post_packet_counter = 0;
+	post_progress_bytes = 0;
 
 	if(boundary_value){
 		free(boundary_value);
@@ -217,7 +231,7 @@ static int httpd_findandstore_firstchunk(void){
 					memcpy((void *)webfailsafe_data_pointer, (void *)end, hs->upload);
 					webfailsafe_data_pointer += hs->upload;
 
-					httpd_download_progress();
+					httpd_download_progress(hs->upload);
 
 					return(1);
 			}
@@ -531,6 +545,9 @@ void httpd_appcall(void){
 				// if we are in STATE_UPLOAD_REQUEST state
 				if(hs->state == STATE_UPLOAD_REQUEST){
 
+					// upload is still going, don't let polling time it out
+					hs->count = 0;
+
 					// end bufor data with NULL
 					uip_appdata[uip_len] = '\0';
 
@@ -557,7 +574,7 @@ void httpd_appcall(void){
 						webfailsafe_data_pointer += uip_len;
 					}
 
-					httpd_download_progress();
+					httpd_download_progress(uip_len);
 
 					// if we have collected all data
 					// Add boundary value and magic packet(+6) to total upload value
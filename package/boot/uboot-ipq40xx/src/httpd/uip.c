@@ -475,6 +475,116 @@ uip_add_rcv_nxt(unsigned short int n)
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
 /*-----------------------------------------------------------------------------------*/
+#if UIP_OOO_SEGMENTS > 0
+/* Segments received ahead of rcv_nxt, waiting for the missing data
+   in front of them to be retransmitted. */
+struct uip_ooo_seg {
+  struct uip_conn *conn;
+  u32_t seqno;
+  u16_t len;
+  u8_t data[UIP_TCP_MSS];
+};
+
+static struct uip_ooo_seg uip_ooo[UIP_OOO_SEGMENTS];
+
+static u32_t
+uip_seq32(volatile u8_t *seqno)
+{
+  return ((u32_t)seqno[0] << 24) | ((u32_t)seqno[1] << 16) |
+    ((u32_t)seqno[2] << 8) | seqno[3];
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+uip_ooo_flush(struct uip_conn *conn)
+{
+  u8_t i;
+
+  for(i = 0; i < UIP_OOO_SEGMENTS; ++i) {
+    if(uip_ooo[i].conn == conn) {
+      uip_ooo[i].conn = NULL;
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Keep the data of the current segment if it lies within the
+   window, ahead of the sequence number we are waiting for. */
+static void
+uip_ooo_store(u16_t hlen)
+{
+  struct uip_ooo_seg *seg = NULL;
+  u32_t seqno, off;
+  u8_t i;
+
+  if(uip_len > UIP_TCP_MSS ||
+     (uip_conn->tcpstateflags & UIP_STOPPED) ||
+     (BUF->flags & (TCP_FIN | TCP_SYN | TCP_URG))) {
+    return;
+  }
+
+  seqno = uip_seq32(BUF->seqno);
+  off = (seqno - uip_seq32(uip_conn->rcv_nxt)) & 0xffffffff;
+
+  if(off == 0 || off >= UIP_RECEIVE_WINDOW) {
+    return;
+  }
+
+  for(i = 0; i < UIP_OOO_SEGMENTS; ++i) {
+    if(uip_ooo[i].conn == uip_conn && uip_ooo[i].seqno == seqno) {
+      /* Already have it. */
+      return;
+    }
+    if(seg == NULL && uip_ooo[i].conn == NULL) {
+      seg = &uip_ooo[i];
+    }
+  }
+
+  if(seg == NULL) {
+    return;
+  }
+
+  seg->conn = uip_conn;
+  seg->seqno = seqno;
+  seg->len = uip_len;
+  memcpy(seg->data, &uip_buf[UIP_LLH_LEN + 20 + hlen], uip_len);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Move the held back segment that continues at rcv_nxt into the
+   packet buffer, dropping the ones that have been overtaken by a
+   retransmission. */
+static u8_t
+uip_ooo_next(void)
+{
+  u32_t rcv_nxt = uip_seq32(uip_conn->rcv_nxt);
+  struct uip_ooo_seg *seg = NULL;
+  u8_t i;
+
+  for(i = 0; i < UIP_OOO_SEGMENTS; ++i) {
+    if(uip_ooo[i].conn != uip_conn) {
+      continue;
+    }
+    if(uip_ooo[i].seqno == rcv_nxt) {
+      seg = &uip_ooo[i];
+    } else if(((uip_ooo[i].seqno - rcv_nxt) & 0xffffffff) >= UIP_RECEIVE_WINDOW) {
+      uip_ooo[i].conn = NULL;
+    }
+  }
+
+  if(seg == NULL) {
+    return 0;
+  }
+
+  uip_appdata = &uip_buf[40 + UIP_LLH_LEN];
+  memcpy((void *)uip_appdata, seg->data, seg->len);
+  uip_len = seg->len;
+  seg->conn = NULL;
+
+  uip_add_rcv_nxt(uip_len);
+  uip_flags = UIP_NEWDATA;
+
+  return 1;
+}
+#endif /* UIP_OOO_SEGMENTS > 0 */
+/*-----------------------------------------------------------------------------------*/
 void
 uip_process(u8_t flag)
 {
@@ -964,6 +1074,10 @@ uip_process(u8_t flag)
   uip_connr->rcv_nxt[0] = BUF->seqno[0];
   uip_add_rcv_nxt(1);
 
+#if UIP_OOO_SEGMENTS > 0
+  uip_ooo_flush(uip_connr);
+#endif /* UIP_OOO_SEGMENTS > 0 */
+
   /* Parse the TCP MSS option, if present. */
   if((BUF->tcpoffset & 0xf0) > 0x50) {
     for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
@@ -1045,12 +1159,19 @@ uip_process(u8_t flag)
 
   /* First, check if the sequence number of the incoming packet is
      what we're expecting next. If not, we send out an ACK with the
-     correct numbers in. */
+     correct numbers in. The duplicate ACK makes the sender
+     retransmit the missing segment, while the data of this one is
+     held back if it fits. */
   if(uip_len > 0 &&
      (BUF->seqno[0] != uip_connr->rcv_nxt[0] ||
       BUF->seqno[1] != uip_connr->rcv_nxt[1] ||
       BUF->seqno[2] != uip_connr->rcv_nxt[2] ||
       BUF->seqno[3] != uip_connr->rcv_nxt[3])) {
+#if UIP_OOO_SEGMENTS > 0
+    if((uip_connr->tcpstateflags & TS_MASK) == ESTABLISHED) {
+      uip_ooo_store(c);
+    }
+#endif /* UIP_OOO_SEGMENTS > 0 */
     goto tcp_send_ack;
   }
 
@@ -1275,6 +1396,19 @@ uip_process(u8_t flag)
       uip_slen = 0;
       UIP_APPCALL();
 
+#if UIP_OOO_SEGMENTS > 0
+      /* Pass on the held back segments that now continue the
+	 stream, one at a time as if they had just arrived. We stop
+	 as soon as the application has something to say, the
+	 acknowledgment then covers everything passed on so far. */
+      while((uip_flags & UIP_NEWDATA) &&
+	    !(uip_flags & (UIP_ABORT | UIP_CLOSE)) &&
+	    !(uip_connr->tcpstateflags & UIP_STOPPED) &&
+	    uip_slen == 0 && uip_ooo_next()) {
+	UIP_APPCALL();
+      }
+#endif /* UIP_OOO_SEGMENTS > 0 */
+
     appsend:
       
 	  if(uip_flags & UIP_ABORT) {
@@ -325,6 +325,18 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_LISTENPORTS 1
 
+/**
+ * The number of out-of-order TCP segments that are held back.
+ *
+ * Segments that arrive after a lost one are kept until the sender
+ * retransmits the missing segment, after which they are passed to the
+ * application in order. Each entry takes UIP_TCP_MSS bytes of
+ * memory. Set to 0 to drop out-of-order segments.
+ *
+ * \hideinitializer
+ */
+#define UIP_OOO_SEGMENTS 16
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -332,10 +344,12 @@ typedef unsigned short uip_stats_t;
  * application is slow to process incoming data, or high (32768 bytes)
  * if the application processes data quickly.
  *
+ * The window covers what can be held in the out-of-order buffer, so
+ * a lost segment does not make us drop the rest of the window.
+ *
  * \hideinitializer
  */
-//#define UIP_RECEIVE_WINDOW   32768
-#define UIP_RECEIVE_WINDOW   3000
+#define UIP_RECEIVE_WINDOW   ((UIP_OOO_SEGMENTS + 1) * UIP_TCP_MSS)
 
 /**
  * Determines if support for TCP urgent data notification should be
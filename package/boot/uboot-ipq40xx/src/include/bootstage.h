@@ -233,6 +233,15 @@ ulong bootstage_mark_name(enum bootstage_id id, const char *name);
 /* Print a report about boot time */
 void bootstage_report(void);
 
+/*
+ * Add the recorded timings to a device tree as a /bootstage node, for
+ * the OS to pick up.
+ *
+ * @param blob	Device tree blob
+ * @return 0 on success, -1 on failure
+ */
+int bootstage_fdt_add_report(void *blob);
+
 #else
 /*
  * This is a dummy implementation which just calls show_boot_progress(),
@@ -256,6 +265,11 @@ static inline ulong bootstage_mark_name(enum bootstage_id id, const char *name)
 	return 0;
 }
 
+static inline int bootstage_fdt_add_report(void *blob)
+{
+	return 0;
+}
+
 
 #endif /* CONFIG_BOOTSTAGE */
 
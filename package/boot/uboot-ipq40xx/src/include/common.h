@@ -296,6 +296,9 @@ void	reset_cmd_timeout(void);
 #ifdef CONFIG_MENU
 int	abortboot(int bootdelay);
 #endif
+#ifdef CONFIG_FASTBOOT
+int	fastboot_enabled(void);
+#endif
 extern char console_buffer[];
 
 /* arch/$(ARCH)/lib/board.c */
@@ -93,6 +93,19 @@
 #define CONFIG_NR_DRAM_BANKS		1
 #define CONFIG_OF_LIBFDT		1
 #define CONFIG_OF_BOARD_SETUP		1
+/* Room for the fixups and the /bootstage node added by ft_board_setup() */
+#define CONFIG_SYS_FDT_PAD		0x5000
+
+/*
+ * Boot stage timestamps, passed to the kernel in the FDT. CONFIG_FASTBOOT
+ * adds the "fastboot" environment switch: autoboot without delay (a key
+ * already pressed still stops it) and verified FIT hashes remembered in
+ * the environment, so an unchanged image is only checked with a CRC32.
+ */
+#define CONFIG_BOOTSTAGE
+#define CONFIG_FASTBOOT
+#define CONFIG_ZERO_BOOTDELAY_CHECK
+#define CONFIG_FIT_HASH_CACHE
 
 /*
  * IPQ_TFTP_MAX_ADDR: Starting address of UBoot load/Execution region.
@@ -604,6 +604,14 @@ int fit_image_hash_set_value(void *fit, int noffset, uint8_t *value,
 
 int fit_image_check_hashes(const void *fit, int noffset);
 int fit_all_image_check_hashes(const void *fit);
+
+#if defined(CONFIG_FIT_HASH_CACHE) && !defined(USE_HOSTCC)
+int fit_hash_cache_lookup(const void *fit, int image_noffset,
+			  const void *data, size_t size);
+void fit_hash_cache_add(const void *fit, int image_noffset,
+			const void *data, size_t size);
+void fit_hash_cache_commit(void);
+#endif
 int fit_image_check_os(const void *fit, int noffset, uint8_t os);
 int fit_image_check_arch(const void *fit, int noffset, uint8_t arch);
 int fit_image_check_type(const void *fit, int noffset, uint8_t type);
@@ -19,17 +19,23 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <arpa/nameser.h>
 #include <arpa/inet.h>
 
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
 #include <resolv.h>
+#include <uci.h>
 
 #include <libubox/avl.h>
 #include <libubox/usock.h>
@@ -57,6 +63,340 @@ static const struct blobmsg_policy rpc_lookup_policy[__RPC_L_MAX] = {
 	[RPC_L_LIMIT]   = { .name = "limit",   .type = BLOBMSG_TYPE_INT32  },
 };
 
+static struct rrdns_config config = {
+	.parallel     = RRDNS_DEF_PARALLEL,
+	.cache_size   = RRDNS_DEF_CACHE_SIZE,
+	.max_ttl      = RRDNS_DEF_MAX_TTL,
+	.negative_ttl = RRDNS_DEF_NEG_TTL,
+};
+
+#define rrdns_stat(cache, field) \
+	do { if ((cache)->hdr) __atomic_fetch_add(&(cache)->hdr->stats.field, 1, __ATOMIC_RELAXED); } while (0)
+
+
+static int64_t
+rrdns_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+rrdns_now(void)
+{
+	return rrdns_now_ms() / 1000;
+}
+
+static void
+rrdns_config_int(struct uci_context *uci, struct uci_section *s,
+                 const char *name, int *val, int min, int max)
+{
+	const char *str = uci_lookup_option_string(uci, s, name);
+	char *end;
+	long v;
+
+	if (!str)
+		return;
+
+	v = strtol(str, &end, 10);
+
+	if (*end || v < min || v > max)
+		return;
+
+	*val = v;
+}
+
+static void
+rrdns_load_config(void)
+{
+	struct uci_context *uci;
+	struct uci_package *pkg;
+	struct uci_section *s;
+
+	uci = uci_alloc_context();
+
+	if (!uci)
+		return;
+
+	if (!uci_load(uci, "rrdns", &pkg)) {
+		s = uci_lookup_section(uci, pkg, "main");
+
+		if (s) {
+			rrdns_config_int(uci, s, "parallel", &config.parallel,
+			                 1, RRDNS_MAX_LIMIT);
+			rrdns_config_int(uci, s, "cache_size", &config.cache_size,
+			                 0, RRDNS_MAX_CACHE_SIZE);
+			rrdns_config_int(uci, s, "max_ttl", &config.max_ttl,
+			                 RRDNS_MIN_TTL, 86400);
+			rrdns_config_int(uci, s, "negative_ttl", &config.negative_ttl,
+			                 RRDNS_MIN_TTL, 86400);
+		}
+	}
+
+	uci_free_context(uci);
+}
+
+static int
+rrdns_cache_open(struct rrdns_cache *cache)
+{
+	struct rrdns_cache_header *hdr;
+	struct stat st;
+	size_t len;
+
+	cache->hdr = NULL;
+	cache->fd = -1;
+
+	if (!config.cache_size)
+		return -ENOENT;
+
+	len = sizeof(*hdr) + config.cache_size * sizeof(hdr->entries[0]);
+	cache->fd = open(RRDNS_CACHE_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+	if (cache->fd < 0)
+		return -errno;
+
+	flock(cache->fd, LOCK_EX);
+
+	/* never shrink, other lookups may still map the old size */
+	if (fstat(cache->fd, &st) ||
+	    (st.st_size < (off_t)len && ftruncate(cache->fd, len)))
+		goto fail;
+
+	hdr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+
+	if (hdr == MAP_FAILED)
+		goto fail;
+
+	if (hdr->magic != RRDNS_CACHE_MAGIC || hdr->size != (uint32_t)config.cache_size) {
+		memset(hdr, 0, len);
+		hdr->magic = RRDNS_CACHE_MAGIC;
+		hdr->size = config.cache_size;
+	}
+
+	flock(cache->fd, LOCK_UN);
+
+	cache->hdr = hdr;
+	cache->len = len;
+
+	return 0;
+
+fail:
+	close(cache->fd);
+	cache->fd = -1;
+
+	return -EIO;
+}
+
+static void
+rrdns_cache_close(struct rrdns_cache *cache)
+{
+	if (cache->hdr)
+		munmap(cache->hdr, cache->len);
+
+	if (cache->fd >= 0)
+		close(cache->fd);
+
+	cache->hdr = NULL;
+	cache->fd = -1;
+}
+
+/* another process may have grown the file past our mapping since */
+static uint32_t
+rrdns_cache_entries(struct rrdns_cache *cache)
+{
+	uint32_t mapped = (cache->len - sizeof(*cache->hdr)) /
+	                  sizeof(cache->hdr->entries[0]);
+
+	return (cache->hdr->size < mapped) ? cache->hdr->size : mapped;
+}
+
+static void
+rrdns_cache_lock(struct rrdns_cache *cache)
+{
+	flock(cache->fd, LOCK_EX);
+}
+
+static void
+rrdns_cache_unlock(struct rrdns_cache *cache)
+{
+	flock(cache->fd, LOCK_UN);
+}
+
+static bool
+rrdns_cache_match(struct rrdns_cache_entry *e, uint16_t family,
+                  const struct in6_addr *addr)
+{
+	return (e->state != RRDNS_CACHE_FREE && e->family == family &&
+	        !memcmp(&e->addr, addr, sizeof(*addr)));
+}
+
+/* entry holding addr, otherwise the free or soonest expiring one of
+ * the probed slots */
+static struct rrdns_cache_entry *
+rrdns_cache_slot(struct rrdns_cache *cache, uint16_t family,
+                 const struct in6_addr *addr)
+{
+	struct rrdns_cache_entry *e, *victim = NULL;
+	uint32_t size = rrdns_cache_entries(cache);
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(addr->s6_addr); i++)
+		hash = (hash ^ addr->s6_addr[i]) * 16777619u;
+
+	for (i = 0; i < RRDNS_CACHE_PROBE; i++) {
+		e = &cache->hdr->entries[(hash + i) % size];
+
+		if (rrdns_cache_match(e, family, addr))
+			return e;
+
+		if (!victim || e->state == RRDNS_CACHE_FREE ||
+		    (victim->state != RRDNS_CACHE_FREE && e->expires < victim->expires))
+			victim = e;
+	}
+
+	return victim;
+}
+
+/* answers addr from the cache or marks it as being queried by us */
+static bool
+rrdns_cache_lookup(struct rrdns_context *rctx, uint16_t family,
+                   const struct in6_addr *addr)
+{
+	struct rrdns_cache_header *hdr = rctx->cache.hdr;
+	char buf[INET6_ADDRSTRLEN];
+	struct rrdns_cache_entry *e;
+	struct rrdns_waiter *w;
+	uint32_t now = rrdns_now();
+	bool done = true;
+
+	if (!hdr)
+		return false;
+
+	rrdns_cache_lock(&rctx->cache);
+
+	e = rrdns_cache_slot(&rctx->cache, family, addr);
+
+	if (!rrdns_cache_match(e, family, addr) || e->expires <= now) {
+		rrdns_stat(&rctx->cache, misses);
+
+		memset(e, 0, sizeof(*e));
+		e->state = RRDNS_CACHE_PENDING;
+		e->family = family;
+		e->addr = *addr;
+		e->expires = now + (rctx->timeout_ms + 999) / 1000;
+
+		done = false;
+	}
+	else if (e->state == RRDNS_CACHE_POSITIVE) {
+		rrdns_stat(&rctx->cache, hits);
+
+		inet_ntop(family, addr, buf, sizeof(buf));
+		blobmsg_add_string(&rctx->blob, buf, e->name);
+	}
+	else if (e->state == RRDNS_CACHE_NEGATIVE) {
+		rrdns_stat(&rctx->cache, negative_hits);
+	}
+	else {
+		w = calloc(1, sizeof(*w));
+
+		if (w) {
+			rrdns_stat(&rctx->cache, coalesced);
+
+			w->family = family;
+			w->addr = *addr;
+			list_add_tail(&w->list, &rctx->waiters);
+		}
+	}
+
+	rrdns_cache_unlock(&rctx->cache);
+
+	return done;
+}
+
+/* records the outcome of our query, RRDNS_CACHE_FREE drops the pending
+ * mark without caching anything */
+static void
+rrdns_cache_store(struct rrdns_context *rctx, struct rrdns_request *req,
+                  int state, const char *name, uint32_t ttl)
+{
+	struct rrdns_cache_header *hdr = rctx->cache.hdr;
+	struct rrdns_cache_entry *e;
+	uint32_t max_ttl;
+
+	if (!hdr)
+		return;
+
+	max_ttl = (state == RRDNS_CACHE_NEGATIVE) ? config.negative_ttl
+	                                          : config.max_ttl;
+
+	if (ttl < RRDNS_MIN_TTL)
+		ttl = RRDNS_MIN_TTL;
+	else if (ttl > max_ttl)
+		ttl = max_ttl;
+
+	if (name && strlen(name) >= sizeof(e->name))
+		state = RRDNS_CACHE_FREE;
+
+	rrdns_cache_lock(&rctx->cache);
+
+	e = rrdns_cache_slot(&rctx->cache, req->family, &req->addr.in6);
+
+	if (state == RRDNS_CACHE_FREE) {
+		if (rrdns_cache_match(e, req->family, &req->addr.in6) &&
+		    e->state == RRDNS_CACHE_PENDING)
+			e->state = RRDNS_CACHE_FREE;
+	}
+	else {
+		memset(e, 0, sizeof(*e));
+		e->state = state;
+		e->family = req->family;
+		e->addr = req->addr.in6;
+		e->expires = rrdns_now() + ttl;
+
+		if (name)
+			strcpy(e->name, name);
+	}
+
+	rrdns_cache_unlock(&rctx->cache);
+}
+
+static void
+rrdns_check_waiters(struct rrdns_context *rctx)
+{
+	struct rrdns_cache_header *hdr = rctx->cache.hdr;
+	struct rrdns_waiter *w, *tmp;
+	char buf[INET6_ADDRSTRLEN];
+	struct rrdns_cache_entry *e;
+	uint32_t now = rrdns_now();
+
+	if (!hdr || list_empty(&rctx->waiters))
+		return;
+
+	rrdns_cache_lock(&rctx->cache);
+
+	list_for_each_entry_safe(w, tmp, &rctx->waiters, list) {
+		e = rrdns_cache_slot(&rctx->cache, w->family, &w->addr);
+
+		if (rrdns_cache_match(e, w->family, &w->addr) && e->expires > now) {
+			if (e->state == RRDNS_CACHE_PENDING)
+				continue;
+
+			if (e->state == RRDNS_CACHE_POSITIVE) {
+				inet_ntop(w->family, &w->addr, buf, sizeof(buf));
+				blobmsg_add_string(&rctx->blob, buf, e->name);
+			}
+		}
+
+		list_del(&w->list);
+		free(w);
+	}
+
+	rrdns_cache_unlock(&rctx->cache);
+}
 
 static int
 rrdns_cmp_id(const void *k1, const void *k2, void *ptr)
@@ -72,14 +412,40 @@ rrdns_cmp_addr(const void *k1, const void *k2, void *ptr)
 	return memcmp(a1, a2, sizeof(*a1));
 }
 
+/* RFC 2308: negative answers live for min(SOA TTL, SOA MINIMUM) */
+static uint32_t
+rrdns_negative_ttl(ns_msg *handle)
+{
+	uint32_t ttl, min;
+	ns_rr rr;
+	int n;
+
+	for (n = 0; n < ns_msg_count(*handle, ns_s_ns); n++) {
+		if (ns_parserr(handle, ns_s_ns, n, &rr))
+			break;
+
+		if (ns_rr_type(rr) != ns_t_soa || ns_rr_rdlen(rr) < 20)
+			continue;
+
+		ttl = ns_rr_ttl(rr);
+		min = ns_get32(ns_rr_rdata(rr) + ns_rr_rdlen(rr) - 4);
+
+		return (ttl < min) ? ttl : min;
+	}
+
+	return config.negative_ttl;
+}
+
 static int
 rrdns_parse_response(struct rrdns_context *rctx)
 {
-	int n, len;
+	int n, len, err = 0;
+	int state = RRDNS_CACHE_FREE;
+	uint32_t ttl = UINT32_MAX;
 	uint16_t id;
 	struct rrdns_request *req;
 	unsigned char res[512];
-	char buf[INET6_ADDRSTRLEN], dname[MAXDNAME];
+	char buf[INET6_ADDRSTRLEN], dname[MAXDNAME], name[MAXDNAME];
 	HEADER *hdr;
 	ns_msg handle;
 	ns_rr rr;
@@ -97,118 +463,193 @@ rrdns_parse_response(struct rrdns_context *rctx)
 		return -ENOENT;
 
 	avl_delete(&rctx->request_ids, &req->by_id);
+	list_del_init(&req->inflight);
 
-	if (ns_initparse(res, len, &handle))
-		return -EINVAL;
+	if (ns_initparse(res, len, &handle)) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* server failures are not cached */
+	if (hdr->rcode != NOERROR && hdr->rcode != NXDOMAIN)
+		goto out;
 
 	for (n = 0; n < ns_msg_count(handle, ns_s_an); n++) {
-		if (ns_parserr(&handle, ns_s_an, n, &rr))
-			return -EINVAL;
+		if (ns_parserr(&handle, ns_s_an, n, &rr)) {
+			err = -EINVAL;
+			goto out;
+		}
 
 		if (ns_rr_type(rr) != ns_t_ptr)
 			continue;
 
 		if (ns_name_uncompress(ns_msg_base(handle), ns_msg_end(handle),
-		                       ns_rr_rdata(rr), dname, sizeof(dname)) < 0)
-			return -EINVAL;
+		                       ns_rr_rdata(rr), dname, sizeof(dname)) < 0) {
+			err = -EINVAL;
+			goto out;
+		}
 
 		inet_ntop(req->family, &req->addr, buf, sizeof(buf));
 		blobmsg_add_string(&rctx->blob, buf, dname);
+
+		if (state != RRDNS_CACHE_POSITIVE)
+			strcpy(name, dname);
+
+		if (ns_rr_ttl(rr) < ttl)
+			ttl = ns_rr_ttl(rr);
+
+		state = RRDNS_CACHE_POSITIVE;
+	}
+
+	if (state != RRDNS_CACHE_POSITIVE) {
+		state = RRDNS_CACHE_NEGATIVE;
+		ttl = rrdns_negative_ttl(&handle);
 	}
 
+out:
+	rrdns_cache_store(rctx, req, err ? RRDNS_CACHE_FREE : state,
+	                  (state == RRDNS_CACHE_POSITIVE) ? name : NULL, ttl);
+
+	return err;
+}
+
+static int
+rrdns_send_query(struct rrdns_context *rctx, struct rrdns_request *req)
+{
+	if (send(rctx->socket.fd, req->query, req->len, 0) != req->len)
+		return -errno;
+
+	req->sent = rrdns_now_ms();
+	req->tries++;
+
+	rrdns_stat(&rctx->cache, queries);
+
 	return 0;
 }
 
 static int
 rrdns_next_query(struct rrdns_context *rctx)
 {
-	const char *addr = NULL, *hex = "0123456789abcdef";
+	const char *addr, *hex = "0123456789abcdef";
 	struct rrdns_request *req;
-	int i, alen, family;
+	int i, alen, family, err;
 	char *p, dname[73];
 
 	union {
 		unsigned char uchar[4];
 		struct in6_addr in6;
 		struct in_addr in;
-	} a = { };
+	} a;
 
-	union {
-		unsigned char buf[512];
-		HEADER hdr;
-	} msg;
+	/* addresses answered from the cache do not take a query slot */
+	while (1) {
+		addr = NULL;
 
-	if (rctx->addr_rem > 0 &&
-	    blob_pad_len(rctx->addr_cur) <= rctx->addr_rem &&
-	    blob_pad_len(rctx->addr_cur) >= sizeof(struct blob_attr)) {
+		if (rctx->addr_rem > 0 &&
+		    blob_pad_len(rctx->addr_cur) <= rctx->addr_rem &&
+		    blob_pad_len(rctx->addr_cur) >= sizeof(struct blob_attr)) {
 
-		addr = blobmsg_get_string(rctx->addr_cur);
-		rctx->addr_rem -= blob_pad_len(rctx->addr_cur);
-		rctx->addr_cur = blob_next(rctx->addr_cur);
-	}
+			addr = blobmsg_get_string(rctx->addr_cur);
+			rctx->addr_rem -= blob_pad_len(rctx->addr_cur);
+			rctx->addr_cur = blob_next(rctx->addr_cur);
+		}
+
+		if (!addr)
+			return 0;
 
-	if (!addr)
-		return 0;
+		memset(&a, 0, sizeof(a));
 
-	if (inet_pton(AF_INET6, addr, &a.in6)) {
-		memset(dname, 0, sizeof(dname));
+		if (inet_pton(AF_INET6, addr, &a.in6)) {
+			memset(dname, 0, sizeof(dname));
 
-		for (i = 0, p = dname; i < 16; i++) {
-			*p++ = hex[a.in6.s6_addr[15-i] % 16];
-			*p++ = '.';
-			*p++ = hex[a.in6.s6_addr[15-i] / 16];
-			*p++ = '.';
+			for (i = 0, p = dname; i < 16; i++) {
+				*p++ = hex[a.in6.s6_addr[15-i] % 16];
+				*p++ = '.';
+				*p++ = hex[a.in6.s6_addr[15-i] / 16];
+				*p++ = '.';
+			}
+
+			p += snprintf(p, p - dname - 1, "ip6.arpa");
+
+			family = AF_INET6;
+			alen = p - dname;
+		}
+		else if (inet_pton(AF_INET, addr, &a.in)) {
+			family = AF_INET;
+			alen = snprintf(dname, sizeof(dname), "%u.%u.%u.%u.in-addr.arpa",
+			                a.uchar[3], a.uchar[2], a.uchar[1], a.uchar[0]);
+		}
+		else {
+			continue;
 		}
 
-		p += snprintf(p, p - dname - 1, "ip6.arpa");
+		if (avl_find(&rctx->request_addrs, &a.in6))
+			continue;
 
-		family = AF_INET6;
-		alen = p - dname;
-	}
-	else if (inet_pton(AF_INET, addr, &a.in)) {
-		family = AF_INET;
-		alen = snprintf(dname, sizeof(dname), "%u.%u.%u.%u.in-addr.arpa",
-		                a.uchar[3], a.uchar[2], a.uchar[1], a.uchar[0]);
-	}
-	else {
-		return -EINVAL;
+		if (!rrdns_cache_lookup(rctx, family, &a.in6))
+			break;
 	}
 
+	req = calloc(1, sizeof(*req));
+
+	if (!req)
+		return -ENOMEM;
+
+	req->family = family;
+	req->addr.in6 = a.in6;
+
 	alen = res_mkquery(QUERY, dname, C_IN, T_PTR, NULL, 0, NULL,
-	                   msg.buf, sizeof(msg.buf));
+	                   req->query, sizeof(req->query));
 
-	if (alen < 0)
-		return alen;
+	if (alen < 0) {
+		err = alen;
+		goto fail;
+	}
 
-	if (avl_find(&rctx->request_addrs, &a.in6))
-		return -ENOTUNIQ;
+	req->len = alen;
+	req->id = ((HEADER *)req->query)->id;
 
-	if (send(rctx->socket.fd, msg.buf, alen, 0) != alen)
-		return -errno;
+	if (avl_find(&rctx->request_ids, &req->id)) {
+		err = -ENOTUNIQ;
+		goto fail;
+	}
 
-	req = calloc(1, sizeof(*req));
+	err = rrdns_send_query(rctx, req);
 
-	if (!req)
-		return -ENOMEM;
+	if (err)
+		goto fail;
 
-	req->id = msg.hdr.id;
 	req->by_id.key = &req->id;
 	avl_insert(&rctx->request_ids, &req->by_id);
 
-	req->family = family;
-	req->addr.in6 = a.in6;
 	req->by_addr.key = &req->addr.in6;
 	avl_insert(&rctx->request_addrs, &req->by_addr);
 
+	list_add_tail(&req->inflight, &rctx->inflight);
+
 	return 0;
+
+fail:
+	rrdns_cache_store(rctx, req, RRDNS_CACHE_FREE, NULL, 0);
+	free(req);
+
+	return err;
+}
+
+static bool
+rrdns_is_done(struct rrdns_context *rctx)
+{
+	return (avl_is_empty(&rctx->request_ids) && list_empty(&rctx->waiters));
 }
 
 static void
 rdns_shutdown(struct rrdns_context *rctx)
 {
 	struct rrdns_request *req, *tmp;
+	struct rrdns_waiter *w, *wtmp;
 
 	uloop_timeout_cancel(&rctx->timeout);
+	uloop_timeout_cancel(&rctx->tick);
 	uloop_fd_delete(&rctx->socket);
 
 	close(rctx->socket.fd);
@@ -217,9 +658,18 @@ rdns_shutdown(struct rrdns_context *rctx)
 	ubus_complete_deferred_request(rctx->context, &rctx->request,
 	                               UBUS_STATUS_OK);
 
+	/* unanswered queries, let the next lookup retry them */
+	list_for_each_entry(req, &rctx->inflight, inflight)
+		rrdns_cache_store(rctx, req, RRDNS_CACHE_FREE, NULL, 0);
+
 	avl_remove_all_elements(&rctx->request_addrs, req, by_addr, tmp)
 		free(req);
 
+	list_for_each_entry_safe(w, wtmp, &rctx->waiters, list)
+		free(w);
+
+	rrdns_cache_close(&rctx->cache);
+
 	blob_buf_free(&rctx->blob);
 	free(rctx);
 }
@@ -233,6 +683,43 @@ rrdns_handle_timeout(struct uloop_timeout *utm)
 	rdns_shutdown(rctx);
 }
 
+static void
+rrdns_handle_tick(struct uloop_timeout *utm)
+{
+	struct rrdns_context *rctx =
+		container_of(utm, struct rrdns_context, tick);
+
+	struct rrdns_request *req, *tmp;
+	int64_t now = rrdns_now_ms();
+
+	list_for_each_entry_safe(req, tmp, &rctx->inflight, inflight) {
+		if (now - req->sent < RRDNS_RETRY_TIMEOUT)
+			continue;
+
+		if (req->tries < 2 && !rrdns_send_query(rctx, req)) {
+			rrdns_stat(&rctx->cache, retries);
+			list_move_tail(&req->inflight, &rctx->inflight);
+			continue;
+		}
+
+		/* give up on this one and hand its slot to the next address */
+		rrdns_stat(&rctx->cache, timeouts);
+		avl_delete(&rctx->request_ids, &req->by_id);
+		list_del_init(&req->inflight);
+		rrdns_cache_store(rctx, req, RRDNS_CACHE_FREE, NULL, 0);
+		rrdns_next_query(rctx);
+	}
+
+	rrdns_check_waiters(rctx);
+
+	if (rrdns_is_done(rctx)) {
+		rdns_shutdown(rctx);
+		return;
+	}
+
+	uloop_timeout_set(utm, RRDNS_TICK_INTERVAL);
+}
+
 static void
 rrdns_handle_response(struct uloop_fd *ufd, unsigned int ev)
 {
@@ -244,18 +731,36 @@ rrdns_handle_response(struct uloop_fd *ufd, unsigned int ev)
 	if (err != -ENODATA && err != -ENOENT)
 		rrdns_next_query(rctx);
 
-	if (avl_is_empty(&rctx->request_ids))
+	if (rrdns_is_done(rctx))
 		rdns_shutdown(rctx);
 }
 
+/* resolv.conf is only parsed again when it changed since the last lookup */
 static char *
-rrdns_find_nameserver(void)
+rrdns_find_nameserver(struct rrdns_cache *cache)
 {
 	static char line[2*INET6_ADDRSTRLEN];
+	struct rrdns_cache_server *srv = NULL;
 	struct in6_addr in6;
 	FILE *resolvconf;
+	struct stat st;
 	char *p;
 
+	if (cache->hdr && !stat("/etc/resolv.conf", &st)) {
+		srv = &cache->hdr->server;
+
+		rrdns_cache_lock(cache);
+
+		if (srv->addr[0] && srv->mtime == st.st_mtime &&
+		    srv->inode == st.st_ino) {
+			strcpy(line, srv->addr);
+			rrdns_cache_unlock(cache);
+			return line;
+		}
+
+		rrdns_cache_unlock(cache);
+	}
+
 	resolvconf = fopen("/etc/resolv.conf", "r");
 
 	if (!resolvconf)
@@ -276,6 +781,15 @@ rrdns_find_nameserver(void)
 			continue;
 
 		fclose(resolvconf);
+
+		if (srv) {
+			rrdns_cache_lock(cache);
+			srv->mtime = st.st_mtime;
+			srv->inode = st.st_ino;
+			strncpy(srv->addr, p, sizeof(srv->addr) - 1);
+			rrdns_cache_unlock(cache);
+		}
+
 		return p;
 	}
 
@@ -283,6 +797,97 @@ rrdns_find_nameserver(void)
 	return NULL;
 }
 
+static int
+rpc_rrdns_stats(struct ubus_context *ctx, struct ubus_object *obj,
+                struct ubus_request_data *req, const char *method,
+                struct blob_attr *msg)
+{
+	uint32_t lookups, answered, now = rrdns_now();
+	int positive = 0, negative = 0, pending = 0;
+	struct rrdns_cache_stats stats;
+	struct rrdns_cache_entry *e;
+	struct rrdns_cache cache;
+	struct blob_buf buf = { };
+	uint32_t i, size;
+
+	rrdns_load_config();
+
+	if (rrdns_cache_open(&cache))
+		return UBUS_STATUS_NOT_FOUND;
+
+	rrdns_cache_lock(&cache);
+
+	size = rrdns_cache_entries(&cache);
+
+	for (i = 0; i < size; i++) {
+		e = &cache.hdr->entries[i];
+
+		if (e->state == RRDNS_CACHE_FREE || e->expires <= now)
+			continue;
+
+		if (e->state == RRDNS_CACHE_POSITIVE)
+			positive++;
+		else if (e->state == RRDNS_CACHE_NEGATIVE)
+			negative++;
+		else
+			pending++;
+	}
+
+	stats = cache.hdr->stats;
+
+	rrdns_cache_unlock(&cache);
+	rrdns_cache_close(&cache);
+
+	answered = stats.hits + stats.negative_hits;
+	lookups = answered + stats.misses + stats.coalesced;
+
+	blob_buf_init(&buf, 0);
+	blobmsg_add_u32(&buf, "size", config.cache_size);
+	blobmsg_add_u32(&buf, "parallel", config.parallel);
+	blobmsg_add_u32(&buf, "positive", positive);
+	blobmsg_add_u32(&buf, "negative", negative);
+	blobmsg_add_u32(&buf, "pending", pending);
+	blobmsg_add_u32(&buf, "hits", stats.hits);
+	blobmsg_add_u32(&buf, "negative_hits", stats.negative_hits);
+	blobmsg_add_u32(&buf, "misses", stats.misses);
+	blobmsg_add_u32(&buf, "coalesced", stats.coalesced);
+	blobmsg_add_u32(&buf, "queries", stats.queries);
+	blobmsg_add_u32(&buf, "retries", stats.retries);
+	blobmsg_add_u32(&buf, "timeouts", stats.timeouts);
+	blobmsg_add_u32(&buf, "hit_rate",
+	                lookups ? (uint64_t)answered * 100 / lookups : 0);
+
+	ubus_send_reply(ctx, req, buf.head);
+	blob_buf_free(&buf);
+
+	return UBUS_STATUS_OK;
+}
+
+static int
+rpc_rrdns_flush(struct ubus_context *ctx, struct ubus_object *obj,
+                struct ubus_request_data *req, const char *method,
+                struct blob_attr *msg)
+{
+	struct rrdns_cache cache;
+
+	rrdns_load_config();
+
+	if (rrdns_cache_open(&cache))
+		return UBUS_STATUS_NOT_FOUND;
+
+	rrdns_cache_lock(&cache);
+
+	memset(&cache.hdr->stats, 0, sizeof(cache.hdr->stats));
+	memset(&cache.hdr->server, 0, sizeof(cache.hdr->server));
+	memset(cache.hdr->entries, 0,
+	       rrdns_cache_entries(&cache) * sizeof(cache.hdr->entries[0]));
+
+	rrdns_cache_unlock(&cache);
+	rrdns_cache_close(&cache);
+
+	return UBUS_STATUS_OK;
+}
+
 static int
 rpc_rrdns_lookup(struct ubus_context *ctx, struct ubus_object *obj,
 	             struct ubus_request_data *req, const char *method,
@@ -322,20 +927,27 @@ rpc_rrdns_lookup(struct ubus_context *ctx, struct ubus_object *obj,
 		return UBUS_STATUS_INVALID_ARGUMENT;
 
 
-	if (!server || !*server)
-		server = rrdns_find_nameserver();
-
-	if (!server)
-		return UBUS_STATUS_NOT_FOUND;
-
 	rctx = calloc(1, sizeof(*rctx));
 
 	if (!rctx)
 		return UBUS_STATUS_UNKNOWN_ERROR;
 
+	rrdns_load_config();
+	rrdns_cache_open(&rctx->cache);
+
+	if (!server || !*server)
+		server = rrdns_find_nameserver(&rctx->cache);
+
+	if (!server) {
+		rrdns_cache_close(&rctx->cache);
+		free(rctx);
+		return UBUS_STATUS_NOT_FOUND;
+	}
+
 	rctx->socket.fd = usock(USOCK_UDP, server, usock_port(port));
 
 	if (rctx->socket.fd < 0) {
+		rrdns_cache_close(&rctx->cache);
 		free(rctx);
 		return UBUS_STATUS_UNKNOWN_ERROR;
 	}
@@ -343,21 +955,34 @@ rpc_rrdns_lookup(struct ubus_context *ctx, struct ubus_object *obj,
 	rctx->context = ctx;
 	rctx->addr_cur = blobmsg_data(tb[RPC_L_ADDRS]);
 	rctx->addr_rem = blobmsg_data_len(tb[RPC_L_ADDRS]);
+	rctx->timeout_ms = timeout;
+	rctx->parallel = (limit < config.parallel) ? limit : config.parallel;
 
 	avl_init(&rctx->request_ids, rrdns_cmp_id, false, NULL);
 	avl_init(&rctx->request_addrs, rrdns_cmp_addr, false, NULL);
+	INIT_LIST_HEAD(&rctx->inflight);
+	INIT_LIST_HEAD(&rctx->waiters);
 
 	rctx->timeout.cb = rrdns_handle_timeout;
-	uloop_timeout_set(&rctx->timeout, timeout);
+	rctx->tick.cb = rrdns_handle_tick;
 
 	rctx->socket.cb = rrdns_handle_response;
 	uloop_fd_add(&rctx->socket, ULOOP_READ);
 
 	blob_buf_init(&rctx->blob, 0);
 
-	while (limit--)
+	for (limit = rctx->parallel; limit > 0; limit--)
 		rrdns_next_query(rctx);
 
+	/* everything came from the cache, reply right away */
+	if (rrdns_is_done(rctx)) {
+		uloop_timeout_set(&rctx->timeout, 0);
+	}
+	else {
+		uloop_timeout_set(&rctx->timeout, timeout);
+		uloop_timeout_set(&rctx->tick, RRDNS_TICK_INTERVAL);
+	}
+
 	ubus_defer_request(ctx, req, &rctx->request);
 
 	return UBUS_STATUS_OK;
@@ -369,6 +994,8 @@ rpc_rrdns_api_init(const struct rpc_daemon_ops *o, struct ubus_context *ctx)
 {
 	static const struct ubus_method rrdns_methods[] = {
 		UBUS_METHOD("lookup", rpc_rrdns_lookup, rpc_lookup_policy),
+		UBUS_METHOD_NOARG("stats", rpc_rrdns_stats),
+		UBUS_METHOD_NOARG("flush", rpc_rrdns_flush),
 	};
 
 	static struct ubus_object_type rrdns_type =
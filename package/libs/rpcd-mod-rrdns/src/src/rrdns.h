@@ -16,8 +16,11 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <netinet/in.h>
+
 #include <libubus.h>
 #include <libubox/avl.h>
+#include <libubox/list.h>
 #include <libubox/uloop.h>
 
 #define RRDNS_MAX_TIMEOUT 5000
@@ -26,26 +29,119 @@
 #define RRDNS_MAX_LIMIT 1000
 #define RRDNS_DEF_LIMIT 10
 
+/* queries on the wire at once, regardless of the requested limit */
+#define RRDNS_DEF_PARALLEL 32
+
+/* an unanswered query is sent once more after this many ms */
+#define RRDNS_RETRY_TIMEOUT 1000
+#define RRDNS_TICK_INTERVAL 25
+
+#define RRDNS_CACHE_PATH "/var/run/rrdns.cache"
+#define RRDNS_CACHE_MAGIC 0x72724331
+#define RRDNS_CACHE_PROBE 8
+
+#define RRDNS_DEF_CACHE_SIZE 2048
+#define RRDNS_MAX_CACHE_SIZE 65536
+
+#define RRDNS_MIN_TTL 30
+#define RRDNS_DEF_MAX_TTL 3600
+#define RRDNS_DEF_NEG_TTL 300
+
+
+enum rrdns_cache_state {
+	RRDNS_CACHE_FREE,
+	RRDNS_CACHE_PENDING,
+	RRDNS_CACHE_POSITIVE,
+	RRDNS_CACHE_NEGATIVE,
+};
+
+/*
+ * rpcd runs every plugin call in a forked child, so the cache lives in a
+ * file on tmpfs mapped by each lookup and guarded with flock().
+ */
+struct rrdns_cache_entry {
+	uint32_t expires;
+	uint8_t state;
+	uint8_t family;
+	uint16_t pad;
+	struct in6_addr addr;
+	char name[104];
+};
+
+struct rrdns_cache_stats {
+	uint32_t hits;
+	uint32_t negative_hits;
+	uint32_t misses;
+	uint32_t coalesced;
+	uint32_t queries;
+	uint32_t retries;
+	uint32_t timeouts;
+};
+
+struct rrdns_cache_server {
+	int64_t mtime;
+	uint64_t inode;
+	char addr[INET6_ADDRSTRLEN];
+};
+
+struct rrdns_cache_header {
+	uint32_t magic;
+	uint32_t size;
+	struct rrdns_cache_stats stats;
+	struct rrdns_cache_server server;
+	struct rrdns_cache_entry entries[];
+};
+
+struct rrdns_cache {
+	int fd;
+	size_t len;
+	struct rrdns_cache_header *hdr;
+};
+
+struct rrdns_config {
+	int parallel;
+	int cache_size;
+	int max_ttl;
+	int negative_ttl;
+};
 
 struct rrdns_request {
 	struct avl_node by_id;
 	struct avl_node by_addr;
+	struct list_head inflight;
 	uint16_t id;
 	uint16_t family;
 	union {
 		struct in_addr in;
 		struct in6_addr in6;
 	} addr;
+	int64_t sent;
+	int tries;
+	int len;
+	unsigned char query[128];
+};
+
+/* address another lookup is already querying */
+struct rrdns_waiter {
+	struct list_head list;
+	uint16_t family;
+	struct in6_addr addr;
 };
 
 struct rrdns_context {
 	struct ubus_context *context;
 	struct ubus_request_data request;
 	struct uloop_timeout timeout;
+	struct uloop_timeout tick;
 	struct blob_attr *addr_cur;
 	int addr_rem;
 	struct uloop_fd socket;
 	struct blob_buf blob;
 	struct avl_tree request_ids;
 	struct avl_tree request_addrs;
+	struct list_head inflight;
+	struct list_head waiters;
+	struct rrdns_cache cache;
+	int parallel;
+	int timeout_ms;
 };
@@ -16,5 +16,9 @@ add_limit_rules() {
 	}
 }
 
+# the nftables backend generates these rules itself, fw3 keeps this state
+# file while its nftables ruleset is loaded
+[ -e /var/run/fw3.nft ] && exit 0
+
 config_load firewall
 config_foreach add_limit_rules rule
\ No newline at end of file
@@ -0,0 +1,1024 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * packet-steeringd places network interrupts and RPS/XPS masks on CPUs
+ * by measured load, replacing default_rps() from /lib/functions/smp.sh
+ * which spreads every receive queue over all CPUs.
+ *
+ * Every interval the daemon samples /proc/interrupts and
+ * /proc/net/softnet_stat and then:
+ *
+ *  - moves network IRQs, heaviest first, to the least loaded CPU, taking
+ *    the load of the IRQs it does not manage into account; an IRQ only
+ *    moves when that clearly lowers the load of its current CPU,
+ *  - steers the receive queues of a device whose IRQs are known to the
+ *    other CPUs of the IRQ's cluster, so the packets stay cache local,
+ *  - steers devices without an IRQ of their own (qmimux, WireGuard, ...)
+ *    to the CPUs carrying no network IRQ, or the least busy ones by
+ *    softnet_stat if every CPU has one,
+ *  - spreads multiqueue transmit queues over the same CPUs with XPS.
+ *
+ * "pin" sections place the IRQs and queues of matching devices on fixed
+ * CPUs, exclusively if requested. Link events are followed over rtnetlink
+ * so new devices are set up right away, SIGHUP reloads the configuration.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+#include <libubox/list.h>
+#include <libubox/uloop.h>
+#include <libubox/utils.h>
+#include <uci.h>
+
+#define SYSFS_NET		"/sys/class/net"
+#define SYSFS_CPU		"/sys/devices/system/cpu"
+
+#define MAX_CPUS		32
+#define MAX_PATTERNS		16
+#define LINK_SETTLE_MS		1000
+
+/* an IRQ moves only if its CPU is this much (in %) busier than the best,
+ * plus MOVE_SLACK interrupts per second so idle IRQs are left alone
+ */
+#define MOVE_THRESHOLD		25
+#define MOVE_SLACK		100
+
+#define LOG(lvl, fmt, ...) syslog(lvl, fmt, ## __VA_ARGS__)
+
+typedef uint32_t cpumask_t;
+
+struct pattern_list {
+	int n;
+	char *p[MAX_PATTERNS];
+};
+
+struct pin {
+	struct list_head list;
+	char *device;
+	char *irq;
+	cpumask_t cpus;
+	bool exclusive;
+};
+
+struct irq_info {
+	struct list_head list;
+	int irq;
+	char name[64];
+	bool seen;
+	bool sampled;
+	bool managed;
+	bool immovable;
+
+	uint64_t total;
+	uint64_t per_cpu[MAX_CPUS];
+	uint64_t rate;
+	uint64_t cpu_rate[MAX_CPUS];
+
+	/* current smp_affinity as last read or written */
+	cpumask_t affinity;
+};
+
+struct cpu_info {
+	int cluster;
+	uint64_t processed;
+	uint64_t squeezed;
+	uint64_t softnet_rate;
+	uint64_t load;
+};
+
+static struct {
+	bool enabled;
+	int interval;
+	struct pattern_list irqs;
+	struct pattern_list virt;
+	struct list_head pins;
+} config = {
+	.pins = LIST_HEAD_INIT(config.pins),
+};
+
+static LIST_HEAD(irqs);
+static struct cpu_info cpus[MAX_CPUS];
+static int ncpus;
+static cpumask_t online;
+static uint64_t last_sample;
+static bool reload;
+
+static struct uloop_timeout balance_timer;
+static struct uloop_fd rtnl_fd = { .fd = -1 };
+
+static const char * const default_irqs[] = {
+	"*eth*", "*edma*", "ath*", "wlan*", "*wifi*", "*xhci*", "*ehci*",
+	"*dwc3*", "mhi*", "*pcie*",
+};
+
+static const char * const default_virt[] = {
+	"qmimux*",
+};
+
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool
+pattern_match(struct pattern_list *l, const char *name)
+{
+	int i;
+
+	for (i = 0; i < l->n; i++)
+		if (!fnmatch(l->p[i], name, 0))
+			return true;
+
+	return false;
+}
+
+static int
+cpu_first(cpumask_t mask)
+{
+	return mask ? __builtin_ctz(mask) : -1;
+}
+
+static int
+cpu_count(cpumask_t mask)
+{
+	return __builtin_popcount(mask);
+}
+
+/* sysfs helpers */
+
+static int
+read_line(const char *path, char *buf, size_t len)
+{
+	FILE *f = fopen(path, "r");
+	char *nl;
+
+	if (!f)
+		return -1;
+
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+
+	fclose(f);
+
+	nl = strchr(buf, '\n');
+	if (nl)
+		*nl = 0;
+
+	return 0;
+}
+
+static int
+read_int(const char *path, int def)
+{
+	char buf[32];
+
+	if (read_line(path, buf, sizeof(buf)))
+		return def;
+
+	return atoi(buf);
+}
+
+/* masks are read back as comma separated 32 bit groups */
+static cpumask_t
+read_mask(const char *path)
+{
+	char buf[128], *p;
+
+	if (read_line(path, buf, sizeof(buf)))
+		return 0;
+
+	p = strrchr(buf, ',');
+
+	return strtoul(p ? p + 1 : buf, NULL, 16);
+}
+
+/* returns 1 if the mask was changed, 0 if it was already set, -1 on error */
+static int
+write_mask(const char *path, cpumask_t mask)
+{
+	char buf[16];
+	int fd, len;
+
+	if (read_mask(path) == mask)
+		return 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+
+	len = snprintf(buf, sizeof(buf), "%x\n", mask);
+	if (write(fd, buf, len) != len) {
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+
+	return 1;
+}
+
+/* topology */
+
+static void
+cpus_init(void)
+{
+	char path[128];
+	int i;
+
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus > MAX_CPUS)
+		ncpus = MAX_CPUS;
+
+	online = 0;
+	for (i = 0; i < ncpus; i++) {
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/online", i);
+		if (read_int(path, 1))
+			online |= 1U << i;
+
+		/* cluster_id is missing on older kernels, fall back to the package */
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/cluster_id", i);
+		cpus[i].cluster = read_int(path, -1);
+		if (cpus[i].cluster < 0) {
+			snprintf(path, sizeof(path),
+				 SYSFS_CPU "/cpu%d/topology/physical_package_id", i);
+			cpus[i].cluster = read_int(path, 0);
+		}
+	}
+}
+
+static cpumask_t
+cluster_mask(int cpu)
+{
+	cpumask_t mask = 0;
+	int i;
+
+	for (i = 0; i < ncpus; i++)
+		if (cpus[i].cluster == cpus[cpu].cluster)
+			mask |= 1U << i;
+
+	return mask & online;
+}
+
+/* CPUs available to traffic that is not pinned exclusively elsewhere */
+static cpumask_t
+pool_mask(void)
+{
+	cpumask_t mask = online;
+	struct pin *pin;
+
+	list_for_each_entry(pin, &config.pins, list)
+		if (pin->exclusive)
+			mask &= ~pin->cpus;
+
+	return mask ? mask : online;
+}
+
+static struct pin *
+pin_find(const char *device, const char *irq)
+{
+	struct pin *pin;
+
+	list_for_each_entry(pin, &config.pins, list) {
+		if (device && pin->device && !fnmatch(pin->device, device, 0))
+			return pin;
+
+		if (irq && pin->irq && !fnmatch(pin->irq, irq, 0))
+			return pin;
+
+		/* IRQs are commonly named after the device they serve */
+		if (irq && pin->device && !pin->irq && strstr(irq, pin->device))
+			return pin;
+	}
+
+	return NULL;
+}
+
+/* load sampling */
+
+static struct irq_info *
+irq_get(int nr)
+{
+	struct irq_info *irq;
+	char path[64];
+
+	list_for_each_entry(irq, &irqs, list)
+		if (irq->irq == nr)
+			return irq;
+
+	irq = calloc(1, sizeof(*irq));
+	if (!irq)
+		return NULL;
+
+	irq->irq = nr;
+	snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity", nr);
+	irq->affinity = read_mask(path);
+	list_add_tail(&irq->list, &irqs);
+
+	return irq;
+}
+
+static void
+sample_interrupts(uint64_t elapsed)
+{
+	struct irq_info *irq, *tmp;
+	char line[1024], *p, *end, *name;
+	int ncols = 0, i, nr;
+	uint64_t count;
+	FILE *f;
+
+	f = fopen("/proc/interrupts", "r");
+	if (!f)
+		return;
+
+	/* the header names one column per online CPU */
+	if (fgets(line, sizeof(line), f))
+		for (p = line; (p = strstr(p, "CPU")); p += 3)
+			ncols++;
+
+	list_for_each_entry(irq, &irqs, list)
+		irq->seen = false;
+
+	while (fgets(line, sizeof(line), f)) {
+		p = line;
+		while (isspace(*p))
+			p++;
+
+		nr = strtol(p, &end, 10);
+		if (end == p || *end != ':')
+			continue;
+
+		irq = irq_get(nr);
+		if (!irq)
+			continue;
+
+		p = end + 1;
+		count = 0;
+		for (i = 0; i < ncols && i < MAX_CPUS; i++) {
+			uint64_t c = strtoull(p, &end, 10);
+
+			if (end == p)
+				break;
+
+			p = end;
+			irq->cpu_rate[i] = irq->sampled && elapsed && c >= irq->per_cpu[i] ?
+				(c - irq->per_cpu[i]) * 1000 / elapsed : 0;
+			irq->per_cpu[i] = c;
+			count += c;
+		}
+
+		irq->rate = irq->sampled && elapsed && count >= irq->total ?
+			(count - irq->total) * 1000 / elapsed : 0;
+		irq->total = count;
+		irq->sampled = true;
+		irq->seen = true;
+
+		/* the action name is the last field of the line */
+		end = p + strlen(p);
+		while (end > p && isspace(end[-1]))
+			*--end = 0;
+		name = end;
+		while (name > p && !isspace(name[-1]))
+			name--;
+
+		snprintf(irq->name, sizeof(irq->name), "%s", name);
+		irq->managed = !irq->immovable &&
+			       (pattern_match(&config.irqs, irq->name) ||
+				pin_find(NULL, irq->name));
+	}
+
+	fclose(f);
+
+	list_for_each_entry_safe(irq, tmp, &irqs, list) {
+		if (irq->seen)
+			continue;
+
+		list_del(&irq->list);
+		free(irq);
+	}
+}
+
+static void
+sample_softnet(uint64_t elapsed)
+{
+	unsigned int processed, dropped, squeezed;
+	char line[512];
+	int cpu = 0;
+	FILE *f;
+
+	f = fopen("/proc/net/softnet_stat", "r");
+	if (!f)
+		return;
+
+	/* one line per possible CPU, the CPU id is only in newer kernels */
+	while (fgets(line, sizeof(line), f) && cpu < MAX_CPUS) {
+		if (sscanf(line, "%x %x %x", &processed, &dropped, &squeezed) != 3)
+			break;
+
+		cpus[cpu].softnet_rate = elapsed && processed >= cpus[cpu].processed ?
+			(uint64_t)(processed - cpus[cpu].processed) * 1000 / elapsed : 0;
+
+		if (last_sample && squeezed > cpus[cpu].squeezed)
+			LOG(LOG_DEBUG, "cpu%d: softirq budget ran out %u times",
+			    cpu, squeezed - (unsigned int)cpus[cpu].squeezed);
+
+		cpus[cpu].processed = processed;
+		cpus[cpu].squeezed = squeezed;
+		cpu++;
+	}
+
+	fclose(f);
+}
+
+/* IRQ placement */
+
+static int
+irq_cmp(const void *a, const void *b)
+{
+	const struct irq_info *ia = *(const struct irq_info **)a;
+	const struct irq_info *ib = *(const struct irq_info **)b;
+
+	return (ia->rate < ib->rate) - (ia->rate > ib->rate);
+}
+
+static void
+irq_apply(struct irq_info *irq, cpumask_t mask)
+{
+	char path[64];
+
+	snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity", irq->irq);
+	switch (write_mask(path, mask)) {
+	case 1:
+		LOG(LOG_INFO, "irq %d (%s): cpus %x", irq->irq, irq->name, mask);
+		/* fall through */
+	case 0:
+		irq->affinity = mask;
+		break;
+	default:
+		/* per-CPU and managed IRQs refuse affinity changes */
+		LOG(LOG_NOTICE, "irq %d (%s): affinity is fixed, leaving it alone",
+		    irq->irq, irq->name);
+		irq->immovable = true;
+		irq->managed = false;
+		break;
+	}
+}
+
+static void
+balance_irqs(void)
+{
+	struct irq_info *irq, **list;
+	cpumask_t pool = pool_mask();
+	struct pin *pin;
+	int n = 0, i, cpu, best, cur;
+
+	for (cpu = 0; cpu < ncpus; cpu++)
+		cpus[cpu].load = 0;
+
+	/* start from the load nothing here can move */
+	list_for_each_entry(irq, &irqs, list) {
+		if (irq->managed)
+			n++;
+		else
+			for (cpu = 0; cpu < ncpus; cpu++)
+				cpus[cpu].load += irq->cpu_rate[cpu];
+	}
+
+	list = calloc(n ? n : 1, sizeof(*list));
+	if (!list)
+		return;
+
+	n = 0;
+	list_for_each_entry(irq, &irqs, list) {
+		if (!irq->managed)
+			continue;
+
+		pin = pin_find(NULL, irq->name);
+		if (pin) {
+			irq_apply(irq, pin->cpus & online);
+			cpu = cpu_first(pin->cpus & online);
+			if (cpu >= 0)
+				cpus[cpu].load += irq->rate;
+			continue;
+		}
+
+		list[n++] = irq;
+	}
+
+	qsort(list, n, sizeof(*list), irq_cmp);
+
+	for (i = 0; i < n; i++) {
+		irq = list[i];
+
+		best = -1;
+		for (cpu = 0; cpu < ncpus; cpu++) {
+			if (!(pool & (1U << cpu)))
+				continue;
+
+			if (best < 0 || cpus[cpu].load < cpus[best].load)
+				best = cpu;
+		}
+
+		if (best < 0)
+			break;
+
+		/* stay put unless the move is clearly worth it */
+		cur = cpu_first(irq->affinity & pool);
+		if (cpu_count(irq->affinity) == 1 && cur >= 0 &&
+		    cpus[cur].load * 100 <= cpus[best].load * (100 + MOVE_THRESHOLD) +
+					     MOVE_SLACK * 100)
+			best = cur;
+
+		irq_apply(irq, 1U << best);
+		cpus[best].load += irq->rate;
+	}
+
+	free(list);
+}
+
+/* queue steering */
+
+static cpumask_t
+device_irq_cpus(const char *dev)
+{
+	char path[PATH_MAX], link[PATH_MAX], *driver = NULL;
+	struct irq_info *irq;
+	cpumask_t mask = 0;
+	ssize_t len;
+
+	snprintf(path, sizeof(path), SYSFS_NET "/%s/device/driver", dev);
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len > 0) {
+		link[len] = 0;
+		driver = strrchr(link, '/');
+		driver = driver ? driver + 1 : link;
+	}
+
+	list_for_each_entry(irq, &irqs, list) {
+		if (!irq->managed || !irq->affinity)
+			continue;
+
+		if (strstr(irq->name, dev) ||
+		    (driver && strstr(irq->name, driver)))
+			mask |= irq->affinity;
+	}
+
+	return mask;
+}
+
+static cpumask_t
+irq_busy_cpus(void)
+{
+	struct irq_info *irq;
+	cpumask_t mask = 0;
+
+	list_for_each_entry(irq, &irqs, list)
+		if (irq->managed && irq->rate)
+			mask |= irq->affinity;
+
+	return mask;
+}
+
+static cpumask_t
+least_busy_cpus(cpumask_t pool)
+{
+	int order[MAX_CPUS], n = 0, i, j, tmp, want;
+	cpumask_t mask = 0;
+
+	for (i = 0; i < ncpus; i++)
+		if (pool & (1U << i))
+			order[n++] = i;
+
+	for (i = 1; i < n; i++)
+		for (j = i; j > 0 && cpus[order[j]].softnet_rate <
+				     cpus[order[j - 1]].softnet_rate; j--) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+
+	want = (n + 1) / 2;
+	for (i = 0; i < want; i++)
+		mask |= 1U << order[i];
+
+	return mask;
+}
+
+static cpumask_t
+rps_mask(const char *dev, bool has_device)
+{
+	cpumask_t pool = pool_mask(), irq_cpus, mask;
+	struct pin *pin;
+	int cpu;
+
+	pin = pin_find(dev, NULL);
+	if (pin)
+		return pin->cpus & online;
+
+	irq_cpus = has_device ? device_irq_cpus(dev) : 0;
+	if (irq_cpus) {
+		/* the other CPUs sharing a cache with the receiving one */
+		cpu = cpu_first(irq_cpus);
+		mask = cluster_mask(cpu) & pool & ~irq_cpus;
+
+		return mask ? mask : cluster_mask(cpu) & pool;
+	}
+
+	mask = pool & ~irq_busy_cpus();
+	if (mask)
+		return mask;
+
+	return least_busy_cpus(pool);
+}
+
+static void
+steer_queues(const char *dev, cpumask_t rps, cpumask_t xps_pool)
+{
+	char path[PATH_MAX], qdir[PATH_MAX];
+	int ntx = 0, idx = 0, cpu;
+	struct dirent *e;
+	DIR *d;
+
+	snprintf(qdir, sizeof(qdir), SYSFS_NET "/%s/queues", dev);
+	d = opendir(qdir);
+	if (!d)
+		return;
+
+	while ((e = readdir(d)) != NULL)
+		if (!strncmp(e->d_name, "tx-", 3))
+			ntx++;
+
+	rewinddir(d);
+
+	while ((e = readdir(d)) != NULL) {
+		if (!strncmp(e->d_name, "rx-", 3)) {
+			snprintf(path, sizeof(path), "%s/%s/rps_cpus", qdir, e->d_name);
+			if (write_mask(path, rps) > 0)
+				LOG(LOG_INFO, "%s %s: rps cpus %x", dev, e->d_name, rps);
+		} else if (!strncmp(e->d_name, "tx-", 3) && ntx > 1 && xps_pool) {
+			/* one CPU per queue, round robin over the allowed ones */
+			idx = atoi(e->d_name + 3) % cpu_count(xps_pool);
+			for (cpu = 0; cpu < ncpus; cpu++) {
+				if (!(xps_pool & (1U << cpu)))
+					continue;
+
+				if (idx-- == 0)
+					break;
+			}
+
+			snprintf(path, sizeof(path), "%s/%s/xps_cpus", qdir, e->d_name);
+			write_mask(path, 1U << cpu);
+		}
+	}
+
+	closedir(d);
+}
+
+static void
+steer_devices(void)
+{
+	char path[PATH_MAX];
+	struct dirent *e;
+	struct pin *pin;
+	bool has_device;
+	cpumask_t rps;
+	DIR *d;
+
+	d = opendir(SYSFS_NET);
+	if (!d)
+		return;
+
+	while ((e = readdir(d)) != NULL) {
+		if (e->d_name[0] == '.' || !strcmp(e->d_name, "lo"))
+			continue;
+
+		snprintf(path, sizeof(path), SYSFS_NET "/%s/device", e->d_name);
+		has_device = !access(path, F_OK);
+
+		pin = pin_find(e->d_name, NULL);
+		if (!has_device && !pin && !pattern_match(&config.virt, e->d_name))
+			continue;
+
+		rps = rps_mask(e->d_name, has_device);
+		steer_queues(e->d_name, rps, pin ? pin->cpus & online : pool_mask());
+	}
+
+	closedir(d);
+}
+
+static void
+balance(struct uloop_timeout *t)
+{
+	uint64_t now = now_ms();
+	uint64_t elapsed = last_sample ? now - last_sample : 0;
+
+	sample_interrupts(elapsed);
+	sample_softnet(elapsed);
+	last_sample = now;
+
+	if (cpu_count(online) > 1) {
+		balance_irqs();
+		steer_devices();
+	}
+
+	if (config.interval > 0)
+		uloop_timeout_set(t, config.interval * 1000);
+}
+
+/* link events */
+
+static void
+rtnl_cb(struct uloop_fd *u, unsigned int events)
+{
+	char buf[8192];
+	bool changed = false;
+	struct nlmsghdr *nh;
+	ssize_t len;
+
+	while ((len = recv(u->fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		for (nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, len);
+		     nh = NLMSG_NEXT(nh, len))
+			if (nh->nlmsg_type == RTM_NEWLINK)
+				changed = true;
+	}
+
+	/* let a burst of new devices settle before steering them */
+	if (changed && (!balance_timer.pending ||
+			uloop_timeout_remaining(&balance_timer) > LINK_SETTLE_MS))
+		uloop_timeout_set(&balance_timer, LINK_SETTLE_MS);
+}
+
+static void
+rtnl_open(void)
+{
+	struct sockaddr_nl nl = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK,
+	};
+
+	rtnl_fd.fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (rtnl_fd.fd < 0)
+		return;
+
+	if (bind(rtnl_fd.fd, (struct sockaddr *)&nl, sizeof(nl))) {
+		close(rtnl_fd.fd);
+		rtnl_fd.fd = -1;
+		return;
+	}
+
+	rtnl_fd.cb = rtnl_cb;
+	uloop_fd_add(&rtnl_fd, ULOOP_READ);
+}
+
+/* configuration */
+
+static const char *
+uci_get(struct uci_section *s, const char *opt, const char *def)
+{
+	const char *v = s ? uci_lookup_option_string(s->package->ctx, s, opt) : NULL;
+
+	return v ? v : def;
+}
+
+static int
+uci_get_int(struct uci_section *s, const char *opt, int def)
+{
+	const char *v = uci_get(s, opt, NULL);
+
+	return v ? atoi(v) : def;
+}
+
+static int
+uci_get_bool(struct uci_section *s, const char *opt, int def)
+{
+	const char *v = uci_get(s, opt, NULL);
+
+	if (!v)
+		return def;
+
+	return !strcmp(v, "1") || !strcmp(v, "on") || !strcmp(v, "true") ||
+	       !strcmp(v, "yes") || !strcmp(v, "enabled");
+}
+
+static void
+pattern_add(struct pattern_list *l, const char *p)
+{
+	if (l->n < MAX_PATTERNS)
+		l->p[l->n++] = strdup(p);
+}
+
+static void
+pattern_load(struct pattern_list *l, struct uci_section *s, const char *opt,
+	     const char * const *defs, int ndefs)
+{
+	struct uci_option *o = s ? uci_lookup_option(s->package->ctx, s, opt) : NULL;
+	struct uci_element *e;
+	int i;
+
+	if (!o) {
+		for (i = 0; i < ndefs; i++)
+			pattern_add(l, defs[i]);
+		return;
+	}
+
+	if (o->type == UCI_TYPE_STRING) {
+		pattern_add(l, o->v.string);
+		return;
+	}
+
+	uci_foreach_element(&o->v.list, e)
+		pattern_add(l, e->name);
+}
+
+static void
+pattern_free(struct pattern_list *l)
+{
+	while (l->n > 0)
+		free(l->p[--l->n]);
+}
+
+static cpumask_t
+parse_cpus(struct uci_section *s)
+{
+	struct uci_option *o = uci_lookup_option(s->package->ctx, s, "cpus");
+	struct uci_element *e;
+	cpumask_t mask = 0;
+	char *str, *tok, *save;
+	int cpu;
+
+	if (!o)
+		return 0;
+
+	if (o->type == UCI_TYPE_LIST) {
+		uci_foreach_element(&o->v.list, e) {
+			cpu = atoi(e->name);
+			if (cpu >= 0 && cpu < MAX_CPUS)
+				mask |= 1U << cpu;
+		}
+
+		return mask;
+	}
+
+	str = strdup(o->v.string);
+	if (!str)
+		return 0;
+
+	for (tok = strtok_r(str, " ,", &save); tok; tok = strtok_r(NULL, " ,", &save)) {
+		cpu = atoi(tok);
+		if (cpu >= 0 && cpu < MAX_CPUS)
+			mask |= 1U << cpu;
+	}
+
+	free(str);
+
+	return mask;
+}
+
+static void
+config_free(void)
+{
+	struct pin *pin, *tmp;
+
+	list_for_each_entry_safe(pin, tmp, &config.pins, list) {
+		list_del(&pin->list);
+		free(pin->device);
+		free(pin->irq);
+		free(pin);
+	}
+
+	pattern_free(&config.irqs);
+	pattern_free(&config.virt);
+}
+
+static int
+config_load(void)
+{
+	struct uci_context *uci;
+	struct uci_package *p = NULL;
+	struct uci_element *e;
+	struct uci_section *s;
+	struct pin *pin;
+	const char *v;
+
+	config_free();
+
+	uci = uci_alloc_context();
+	if (!uci)
+		return -1;
+
+	if (uci_load(uci, "packet_steering", &p))
+		p = NULL;
+
+	s = p ? uci_lookup_section(uci, p, "globals") : NULL;
+	config.enabled = uci_get_bool(s, "enabled", 1);
+	config.interval = uci_get_int(s, "interval", 10);
+	pattern_load(&config.irqs, s, "irq", default_irqs, ARRAY_SIZE(default_irqs));
+	pattern_load(&config.virt, s, "virtual", default_virt, ARRAY_SIZE(default_virt));
+
+	if (p) {
+		uci_foreach_element(&p->sections, e) {
+			s = uci_to_section(e);
+			if (strcmp(s->type, "pin"))
+				continue;
+
+			pin = calloc(1, sizeof(*pin));
+			if (!pin)
+				break;
+
+			v = uci_get(s, "device", NULL);
+			pin->device = v ? strdup(v) : NULL;
+			v = uci_get(s, "irq", NULL);
+			pin->irq = v ? strdup(v) : NULL;
+			pin->cpus = parse_cpus(s);
+			pin->exclusive = uci_get_bool(s, "exclusive", 0);
+
+			if ((!pin->device && !pin->irq) || !(pin->cpus & online)) {
+				LOG(LOG_WARNING, "Ignoring pin section \"%s\" without "
+				    "device, irq or valid cpus", s->e.name);
+				free(pin->device);
+				free(pin->irq);
+				free(pin);
+				continue;
+			}
+
+			list_add_tail(&pin->list, &config.pins);
+		}
+	}
+
+	uci_free_context(uci);
+
+	return 0;
+}
+
+static void
+sighup(int sig)
+{
+	reload = true;
+	uloop_end();
+}
+
+int
+main(int argc, char **argv)
+{
+	openlog("packet-steeringd", LOG_PID, LOG_DAEMON);
+
+	cpus_init();
+
+	if (config_load())
+		return 1;
+
+	if (!config.enabled)
+		return 0;
+
+	uloop_init();
+	signal(SIGHUP, sighup);
+
+	rtnl_open();
+	balance_timer.cb = balance;
+
+	do {
+		if (reload) {
+			reload = false;
+			cpus_init();
+			if (config_load() || !config.enabled)
+				break;
+		}
+
+		uloop_timeout_set(&balance_timer, 0);
+		uloop_run();
+	} while (reload);
+
+	if (rtnl_fd.fd >= 0) {
+		uloop_fd_delete(&rtnl_fd);
+		close(rtnl_fd.fd);
+	}
+
+	uloop_done();
+	config_free();
+
+	return 0;
+}
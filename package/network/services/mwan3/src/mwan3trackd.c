@@ -0,0 +1,1481 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mwan3trackd tracks the reachability of several mwan3 interfaces from a
+ * single uloop based process. It replaces one mwan3track shell loop per
+ * interface for the "ping" and "arping" track methods: probes are sent
+ * from raw ICMP/ICMPv6 and ARP sockets bound to the interface device,
+ * source address and mwan3 default firewall mark, so no helper process is
+ * forked per probe.
+ *
+ * The scoring follows mwan3track: the same status files are written to
+ * /var/run/mwan3track/<interface>/ and the same hotplug and ubus events
+ * are emitted on state changes. Interfaces are (re)started and paused
+ * through the "mwan3track" ubus object, which also reports per target
+ * latency, loss, jitter and an RTT histogram.
+ *
+ * Usage: mwan3trackd <interface> [<interface> ...]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/if_ether.h>
+#include <linux/if_packet.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+
+#include <libubox/uloop.h>
+#include <libubox/blobmsg.h>
+#include <libubus.h>
+#include <uci.h>
+
+#define MWAN3_STATUS_DIR	"/var/run/mwan3"
+#define MWAN3TRACK_STATUS_DIR	"/var/run/mwan3track"
+#define HOTPLUG_CALL		"/sbin/hotplug-call"
+
+#define MAX_TARGETS		32
+#define MAX_COUNT		32
+#define PROBE_SPACING		1000
+#define PROBE_MAGIC		0x6d77616e
+
+enum track_method {
+	METHOD_PING,
+	METHOD_ARPING,
+};
+
+static const char * const method_names[] = {
+	[METHOD_PING] = "ping",
+	[METHOD_ARPING] = "arping",
+};
+
+/* upper bounds of the RTT histogram buckets in ms, the last one is open */
+static const unsigned int hist_bounds[] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000
+};
+#define HIST_BUCKETS	(ARRAY_SIZE(hist_bounds) + 1)
+
+union track_addr {
+	struct in_addr in;
+	struct in6_addr in6;
+};
+
+struct track_target {
+	char *host;
+	bool resolved;
+	union track_addr addr;
+
+	/* current round */
+	unsigned int sent;
+	unsigned int received;
+	uint64_t rtt_sum;
+	uint64_t last_send;
+
+	/* results of the last evaluated round, as written to the status files */
+	const char *state;
+	int latency;
+	int loss;
+
+	/* running statistics */
+	uint64_t total_sent;
+	uint64_t total_received;
+	uint32_t last_rtt;
+	uint32_t jitter;
+	uint32_t hist[HIST_BUCKETS];
+};
+
+struct track_iface {
+	struct list_head list;
+
+	char *name;
+	char *cond;
+	enum track_method method;
+	int af;
+
+	int reliability;
+	int count;
+	int timeout;
+	int interval;
+	int down;
+	int up;
+	int size;
+	int max_ttl;
+	int failure_interval;
+	int keep_failure_interval;
+	int recovery_interval;
+	int check_quality;
+	int failure_latency;
+	int recovery_latency;
+	int failure_loss;
+	int recovery_loss;
+	char *initial_state;
+
+	struct track_target targets[MAX_TARGETS];
+	int n_targets;
+
+	/* runtime state */
+	char device[IFNAMSIZ];
+	int ifindex;
+	unsigned char hwaddr[ETH_ALEN];
+	union track_addr src;
+	bool started;
+	const char *status;
+	int score;
+	int host_up_count;
+	int lost;
+	int turn;
+
+	struct uloop_fd sock;
+	struct uloop_timeout probe_timer;
+	struct uloop_timeout round_timer;
+	bool in_round;
+	uint32_t round;
+	int probe_idx;
+	uint16_t ident;
+};
+
+static LIST_HEAD(ifaces);
+static struct ubus_context *ubus_ctx;
+static struct blob_buf b;
+static uint32_t fwmark;
+
+
+static void
+LOG(int prio, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsyslog(prio, fmt, ap);
+	va_end(ap);
+}
+
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long
+get_uptime(void)
+{
+	struct sysinfo si;
+
+	if (sysinfo(&si))
+		return 0;
+
+	return si.uptime;
+}
+
+static void
+write_status(struct track_iface *iface, const char *file, const char *fmt, ...)
+{
+	char path[256];
+	va_list ap;
+	FILE *f;
+
+	snprintf(path, sizeof(path), MWAN3TRACK_STATUS_DIR "/%s/%s", iface->name, file);
+
+	f = fopen(path, "w");
+	if (!f)
+		return;
+
+	va_start(ap, fmt);
+	vfprintf(f, fmt, ap);
+	va_end(ap);
+
+	fputc('\n', f);
+	fclose(f);
+}
+
+static void
+write_target_status(struct track_iface *iface, struct track_target *t, bool quality)
+{
+	char file[128];
+
+	snprintf(file, sizeof(file), "TRACK_%s", t->host);
+	write_status(iface, file, "%s", t->state);
+
+	if (!quality)
+		return;
+
+	snprintf(file, sizeof(file), "LATENCY_%s", t->host);
+	write_status(iface, file, "%d", t->latency);
+	snprintf(file, sizeof(file), "LOSS_%s", t->host);
+	write_status(iface, file, "%d", t->loss);
+}
+
+static void
+send_event(struct track_iface *iface, const char *status)
+{
+	blob_buf_init(&b, 0);
+	blobmsg_add_string(&b, "interface", iface->name);
+	blobmsg_add_string(&b, "status", status);
+	ubus_send_event(ubus_ctx, "mwan3", b.head);
+}
+
+static void
+hotplug(struct track_iface *iface, const char *action, const char *firstconnect)
+{
+	char env_action[64], env_iface[128], env_dev[64], env_first[32];
+	char *envp[5] = { env_action, env_iface, env_dev, NULL, NULL };
+	pid_t pid;
+
+	snprintf(env_action, sizeof(env_action), "ACTION=%s", action);
+	snprintf(env_iface, sizeof(env_iface), "INTERFACE=%s", iface->name);
+	snprintf(env_dev, sizeof(env_dev), "DEVICE=%s", iface->device);
+
+	if (firstconnect) {
+		snprintf(env_first, sizeof(env_first), "FIRSTCONNECT=%s", firstconnect);
+		envp[3] = env_first;
+	}
+
+	/* children are reaped by uloop's SIGCHLD handling */
+	pid = fork();
+	if (pid == 0) {
+		execle(HOTPLUG_CALL, HOTPLUG_CALL, "iface", NULL, envp);
+		_exit(127);
+	} else if (pid < 0) {
+		LOG(LOG_ERR, "Unable to run hotplug for %s: %s", iface->name, strerror(errno));
+	}
+}
+
+
+/* state transitions, see disconnected() and friends in mwan3track */
+
+static void
+iface_disconnected(struct track_iface *iface, bool first)
+{
+	iface->status = "offline";
+	write_status(iface, "STATUS", "offline");
+	write_status(iface, "OFFLINE", "%ld", get_uptime());
+	write_status(iface, "ONLINE", "0");
+	iface->score = 0;
+
+	if (first)
+		return;
+
+	LOG(LOG_NOTICE, "Interface %s (%s) is offline", iface->name, iface->device);
+	hotplug(iface, "disconnected", NULL);
+	send_event(iface, "offline");
+}
+
+static void
+iface_connected(struct track_iface *iface, bool first)
+{
+	iface->status = "online";
+	write_status(iface, "STATUS", "online");
+	write_status(iface, "OFFLINE", "0");
+	write_status(iface, "ONLINE", "%ld", get_uptime());
+	iface->score = iface->down + iface->up;
+	iface->host_up_count = 0;
+	iface->lost = 0;
+	iface->turn = 0;
+
+	LOG(LOG_NOTICE, "Interface %s (%s) is online", iface->name, iface->device);
+	hotplug(iface, "connected", first ? "1" : "");
+	send_event(iface, "online");
+}
+
+static void
+iface_set_transient(struct track_iface *iface, const char *status, const char *verb)
+{
+	if (iface->status && !strcmp(iface->status, status))
+		return;
+
+	iface->status = status;
+	write_status(iface, "STATUS", "%s", status);
+	LOG(LOG_NOTICE, "Interface %s (%s) is %s", iface->name, iface->device, verb);
+	hotplug(iface, status, NULL);
+}
+
+static void
+iface_disabled(struct track_iface *iface)
+{
+	iface->status = "disabled";
+	write_status(iface, "STATUS", "disabled");
+	iface->started = false;
+	send_event(iface, "disabled");
+}
+
+
+/* netifd lookups, see mwan3_get_true_iface and mwan3_get_src_ip */
+
+enum {
+	IFS_UP,
+	IFS_L3_DEVICE,
+	IFS_IPV4_ADDR,
+	IFS_IPV6_ADDR,
+	__IFS_MAX
+};
+
+static const struct blobmsg_policy ifs_policy[__IFS_MAX] = {
+	[IFS_UP] = { "up", BLOBMSG_TYPE_BOOL },
+	[IFS_L3_DEVICE] = { "l3_device", BLOBMSG_TYPE_STRING },
+	[IFS_IPV4_ADDR] = { "ipv4-address", BLOBMSG_TYPE_ARRAY },
+	[IFS_IPV6_ADDR] = { "ipv6-address", BLOBMSG_TYPE_ARRAY },
+};
+
+static const struct blobmsg_policy addr_policy = {
+	"address", BLOBMSG_TYPE_STRING
+};
+
+struct ifstatus {
+	bool found;
+	bool up;
+	char device[IFNAMSIZ];
+	char addr[INET6_ADDRSTRLEN];
+	int af;
+};
+
+static void
+ifstatus_cb(struct ubus_request *req, int type, struct blob_attr *msg)
+{
+	struct ifstatus *st = req->priv;
+	struct blob_attr *tb[__IFS_MAX], *cur, *addr;
+	int rem, idx = (st->af == AF_INET6) ? IFS_IPV6_ADDR : IFS_IPV4_ADDR;
+
+	blobmsg_parse(ifs_policy, __IFS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	st->found = true;
+	st->up = tb[IFS_UP] && blobmsg_get_bool(tb[IFS_UP]);
+
+	if (tb[IFS_L3_DEVICE])
+		snprintf(st->device, sizeof(st->device), "%s",
+			 blobmsg_get_string(tb[IFS_L3_DEVICE]));
+
+	if (!tb[idx])
+		return;
+
+	blobmsg_for_each_attr(cur, tb[idx], rem) {
+		blobmsg_parse(&addr_policy, 1, &addr, blobmsg_data(cur), blobmsg_data_len(cur));
+
+		if (addr) {
+			snprintf(st->addr, sizeof(st->addr), "%s", blobmsg_get_string(addr));
+			break;
+		}
+	}
+}
+
+static bool
+ifstatus_get(const char *name, struct ifstatus *st)
+{
+	char path[128];
+	uint32_t id;
+
+	snprintf(path, sizeof(path), "network.interface.%s", name);
+
+	if (ubus_lookup_id(ubus_ctx, path, &id))
+		return false;
+
+	blob_buf_init(&b, 0);
+	return !ubus_invoke(ubus_ctx, id, "status", b.head, ifstatus_cb, st, 1000) && st->found;
+}
+
+static bool
+device_addr(struct track_iface *iface)
+{
+	struct ifaddrs *ifaddr, *ifa;
+	bool found = false;
+
+	if (getifaddrs(&ifaddr))
+		return false;
+
+	for (ifa = ifaddr; ifa && !found; ifa = ifa->ifa_next) {
+		if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != iface->af ||
+		    strcmp(ifa->ifa_name, iface->device))
+			continue;
+
+		if (iface->af == AF_INET) {
+			iface->src.in = ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr;
+			found = true;
+		} else if (!IN6_IS_ADDR_LINKLOCAL(&((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr)) {
+			iface->src.in6 = ((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr;
+			found = true;
+		}
+	}
+
+	freeifaddrs(ifaddr);
+	return found;
+}
+
+static bool
+resolve_iface(struct track_iface *iface)
+{
+	struct ifstatus st = { .af = iface->af };
+	char true_iface[128];
+	struct ifreq ifr;
+	int fd;
+
+	/* prefer the <iface>_4 / <iface>_6 alias where netifd created one */
+	snprintf(true_iface, sizeof(true_iface), "%s_%d", iface->name,
+		 iface->af == AF_INET6 ? 6 : 4);
+
+	if (!ifstatus_get(true_iface, &st)) {
+		memset(&st, 0, sizeof(st));
+		st.af = iface->af;
+
+		if (!ifstatus_get(iface->name, &st))
+			return false;
+	}
+
+	snprintf(iface->device, sizeof(iface->device), "%s", st.device);
+
+	if (!st.up || !*iface->device)
+		return false;
+
+	iface->ifindex = if_nametoindex(iface->device);
+
+	memset(&iface->src, 0, sizeof(iface->src));
+
+	if (!*st.addr || inet_pton(iface->af, st.addr, &iface->src) != 1) {
+		if (device_addr(iface))
+			LOG(LOG_WARNING, "no src %s address found from netifd for interface '%s' dev '%s'",
+			    iface->af == AF_INET6 ? "ipv6" : "ipv4", iface->name, iface->device);
+		else
+			LOG(LOG_WARNING, "no src %s address found for interface '%s' dev '%s'",
+			    iface->af == AF_INET6 ? "ipv6" : "ipv4", iface->name, iface->device);
+	}
+
+	if (iface->method == METHOD_ARPING) {
+		fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		memset(&ifr, 0, sizeof(ifr));
+		snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", iface->device);
+
+		if (fd < 0 || ioctl(fd, SIOCGIFHWADDR, &ifr)) {
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+
+		memcpy(iface->hwaddr, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+		close(fd);
+	}
+
+	return true;
+}
+
+static void
+resolve_targets(struct track_iface *iface)
+{
+	struct addrinfo hints = { .ai_family = iface->af }, *res;
+	struct track_target *t;
+	int i;
+
+	for (i = 0; i < iface->n_targets; i++) {
+		t = &iface->targets[i];
+
+		if (t->resolved)
+			continue;
+
+		if (inet_pton(iface->af, t->host, &t->addr) == 1) {
+			t->resolved = true;
+			continue;
+		}
+
+		if (getaddrinfo(t->host, NULL, &hints, &res))
+			continue;
+
+		if (iface->af == AF_INET)
+			t->addr.in = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+		else
+			t->addr.in6 = ((struct sockaddr_in6 *)res->ai_addr)->sin6_addr;
+
+		t->resolved = true;
+		freeaddrinfo(res);
+	}
+}
+
+
+/* probing */
+
+struct probe_payload {
+	uint32_t magic;
+	uint32_t round;
+	uint32_t target;
+	uint32_t pad;
+	uint64_t sent;
+};
+
+static void probe_recv(struct uloop_fd *u, unsigned int events);
+
+static void
+sock_close(struct track_iface *iface)
+{
+	if (iface->sock.fd < 0)
+		return;
+
+	uloop_fd_delete(&iface->sock);
+	close(iface->sock.fd);
+	iface->sock.fd = -1;
+}
+
+static bool
+sock_open(struct track_iface *iface)
+{
+	struct sockaddr_ll ll = { 0 };
+	struct sockaddr_in6 sin6 = { 0 };
+	struct sockaddr_in sin = { 0 };
+	struct icmp6_filter filter;
+	int fd, ttl = iface->max_ttl;
+
+	sock_close(iface);
+
+	if (iface->method == METHOD_ARPING)
+		fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, htons(ETH_P_ARP));
+	else if (iface->af == AF_INET6)
+		fd = socket(AF_INET6, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMPV6);
+	else
+		fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+
+	if (fd < 0) {
+		LOG(LOG_ERR, "Unable to open %s socket for %s: %s",
+		    method_names[iface->method], iface->name, strerror(errno));
+		return false;
+	}
+
+	if (iface->method == METHOD_ARPING) {
+		ll.sll_family = AF_PACKET;
+		ll.sll_protocol = htons(ETH_P_ARP);
+		ll.sll_ifindex = iface->ifindex;
+
+		if (bind(fd, (struct sockaddr *)&ll, sizeof(ll)))
+			goto error;
+
+		goto done;
+	}
+
+	/* same socket options the LD_PRELOAD wrapper applies to ping */
+	if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, iface->device, strlen(iface->device) + 1))
+		goto error;
+
+	if (fwmark && setsockopt(fd, SOL_SOCKET, SO_MARK, &fwmark, sizeof(fwmark)))
+		LOG(LOG_WARNING, "Unable to set fwmark on %s socket: %s", iface->name, strerror(errno));
+
+	if (iface->af == AF_INET6) {
+		ICMP6_FILTER_SETBLOCKALL(&filter);
+		ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+		setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+		setsockopt(fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof(ttl));
+
+		sin6.sin6_family = AF_INET6;
+		sin6.sin6_addr = iface->src.in6;
+
+		if (!IN6_IS_ADDR_UNSPECIFIED(&sin6.sin6_addr) &&
+		    bind(fd, (struct sockaddr *)&sin6, sizeof(sin6)))
+			goto error;
+	} else {
+		setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+
+		sin.sin_family = AF_INET;
+		sin.sin_addr = iface->src.in;
+
+		if (sin.sin_addr.s_addr != INADDR_ANY &&
+		    bind(fd, (struct sockaddr *)&sin, sizeof(sin)))
+			goto error;
+	}
+
+done:
+	iface->sock.fd = fd;
+	iface->sock.cb = probe_recv;
+	uloop_fd_add(&iface->sock, ULOOP_READ);
+	return true;
+
+error:
+	LOG(LOG_ERR, "Unable to bind %s socket to %s: %s",
+	    method_names[iface->method], iface->device, strerror(errno));
+	close(fd);
+	return false;
+}
+
+static uint16_t
+icmp_cksum(const void *data, size_t len)
+{
+	const uint16_t *p = data;
+	uint32_t sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *p++;
+
+	if (len)
+		sum += *(const uint8_t *)p;
+
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+
+	return ~sum;
+}
+
+static void
+send_ping(struct track_iface *iface, int idx)
+{
+	struct track_target *t = &iface->targets[idx];
+	size_t len = sizeof(struct icmphdr) + iface->size;
+	struct probe_payload pl = {
+		.magic = PROBE_MAGIC,
+		.round = iface->round,
+		.target = idx,
+		.sent = now_us(),
+	};
+	uint8_t pkt[sizeof(struct icmphdr) + 65507];
+	struct icmphdr *icmp = (struct icmphdr *)pkt;
+	union {
+		struct sockaddr_in in;
+		struct sockaddr_in6 in6;
+	} dst = { 0 };
+	socklen_t dlen;
+
+	memset(pkt, 0, len);
+	icmp->type = (iface->af == AF_INET6) ? ICMP6_ECHO_REQUEST : ICMP_ECHO;
+	icmp->un.echo.id = htons(iface->ident);
+	icmp->un.echo.sequence = htons(iface->probe_idx);
+	memcpy(pkt + sizeof(*icmp), &pl, sizeof(pl));
+
+	if (iface->af == AF_INET6) {
+		/* the kernel fills in the ICMPv6 checksum */
+		dst.in6.sin6_family = AF_INET6;
+		dst.in6.sin6_addr = t->addr.in6;
+		dlen = sizeof(dst.in6);
+	} else {
+		icmp->checksum = icmp_cksum(pkt, len);
+		dst.in.sin_family = AF_INET;
+		dst.in.sin_addr = t->addr.in;
+		dlen = sizeof(dst.in);
+	}
+
+	t->last_send = pl.sent;
+
+	if (sendto(iface->sock.fd, pkt, len, 0, (struct sockaddr *)&dst, dlen) < 0)
+		LOG(LOG_DEBUG, "ping %s on %s failed: %s", t->host, iface->name, strerror(errno));
+
+	t->sent++;
+}
+
+struct arp_pkt {
+	struct arphdr hdr;
+	uint8_t sha[ETH_ALEN];
+	uint8_t spa[4];
+	uint8_t tha[ETH_ALEN];
+	uint8_t tpa[4];
+} __attribute__((packed));
+
+static void
+send_arp(struct track_iface *iface, int idx)
+{
+	struct track_target *t = &iface->targets[idx];
+	struct sockaddr_ll ll = {
+		.sll_family = AF_PACKET,
+		.sll_protocol = htons(ETH_P_ARP),
+		.sll_ifindex = iface->ifindex,
+		.sll_halen = ETH_ALEN,
+		.sll_addr = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	};
+	struct arp_pkt arp = {
+		.hdr = {
+			.ar_hrd = htons(ARPHRD_ETHER),
+			.ar_pro = htons(ETH_P_IP),
+			.ar_hln = ETH_ALEN,
+			.ar_pln = 4,
+			.ar_op = htons(ARPOP_REQUEST),
+		},
+	};
+
+	memcpy(arp.sha, iface->hwaddr, ETH_ALEN);
+	memcpy(arp.spa, &iface->src.in, 4);
+	memcpy(arp.tpa, &t->addr.in, 4);
+
+	t->last_send = now_us();
+
+	if (sendto(iface->sock.fd, &arp, sizeof(arp), 0, (struct sockaddr *)&ll, sizeof(ll)) < 0)
+		LOG(LOG_DEBUG, "arping %s on %s failed: %s", t->host, iface->name, strerror(errno));
+
+	t->sent++;
+}
+
+static void
+account_reply(struct track_iface *iface, struct track_target *t, uint64_t sent)
+{
+	uint64_t now = now_us();
+	uint32_t rtt = (now > sent) ? now - sent : 0;
+	uint32_t diff;
+	unsigned int i;
+
+	if (t->received >= t->sent)
+		return;
+
+	t->received++;
+	t->total_received++;
+	t->rtt_sum += rtt;
+
+	/* RFC 3550 style smoothed interarrival jitter */
+	if (t->total_received > 1) {
+		diff = (rtt > t->last_rtt) ? rtt - t->last_rtt : t->last_rtt - rtt;
+		t->jitter += ((int32_t)diff - (int32_t)t->jitter) / 16;
+	}
+	t->last_rtt = rtt;
+
+	for (i = 0; i < ARRAY_SIZE(hist_bounds); i++)
+		if (rtt < hist_bounds[i] * 1000)
+			break;
+
+	t->hist[i]++;
+}
+
+static void round_start(struct track_iface *iface);
+static void round_finish(struct track_iface *iface);
+
+static bool
+round_complete(struct track_iface *iface)
+{
+	int i;
+
+	if (iface->probe_idx < iface->count)
+		return false;
+
+	for (i = 0; i < iface->n_targets; i++)
+		if (iface->targets[i].resolved &&
+		    iface->targets[i].received < (unsigned int)iface->count)
+			return false;
+
+	return true;
+}
+
+static void
+probe_recv_ping(struct track_iface *iface)
+{
+	uint8_t buf[sizeof(struct iphdr) + 60 + sizeof(struct icmphdr) + 65507];
+	union {
+		struct sockaddr_in in;
+		struct sockaddr_in6 in6;
+	} from;
+	socklen_t flen = sizeof(from);
+	struct probe_payload pl;
+	struct icmphdr *icmp;
+	struct track_target *t;
+	ssize_t len, off = 0;
+
+	while ((len = recvfrom(iface->sock.fd, buf, sizeof(buf), 0,
+			       (struct sockaddr *)&from, &flen)) > 0) {
+		flen = sizeof(from);
+
+		/* raw IPv4 sockets deliver the IP header as well */
+		if (iface->af == AF_INET)
+			off = ((struct iphdr *)buf)->ihl * 4;
+
+		if (len < off + (ssize_t)(sizeof(*icmp) + sizeof(pl)))
+			continue;
+
+		icmp = (struct icmphdr *)(buf + off);
+
+		if (icmp->type != ((iface->af == AF_INET6) ? ICMP6_ECHO_REPLY : ICMP_ECHOREPLY) ||
+		    ntohs(icmp->un.echo.id) != iface->ident)
+			continue;
+
+		memcpy(&pl, buf + off + sizeof(*icmp), sizeof(pl));
+
+		if (pl.magic != PROBE_MAGIC || pl.round != iface->round ||
+		    pl.target >= (uint32_t)iface->n_targets)
+			continue;
+
+		t = &iface->targets[pl.target];
+
+		if (iface->af == AF_INET6 ?
+		    memcmp(&from.in6.sin6_addr, &t->addr.in6, sizeof(t->addr.in6)) :
+		    from.in.sin_addr.s_addr != t->addr.in.s_addr)
+			continue;
+
+		account_reply(iface, t, pl.sent);
+	}
+}
+
+static void
+probe_recv_arp(struct track_iface *iface)
+{
+	struct arp_pkt arp;
+	struct track_target *t;
+	ssize_t len;
+	int i;
+
+	while ((len = recv(iface->sock.fd, &arp, sizeof(arp), 0)) > 0) {
+		if (len < (ssize_t)sizeof(arp) || arp.hdr.ar_op != htons(ARPOP_REPLY))
+			continue;
+
+		for (i = 0; i < iface->n_targets; i++) {
+			t = &iface->targets[i];
+
+			if (t->resolved && !memcmp(arp.spa, &t->addr.in, 4))
+				account_reply(iface, t, t->last_send);
+		}
+	}
+}
+
+static void
+probe_recv(struct uloop_fd *u, unsigned int events)
+{
+	struct track_iface *iface = container_of(u, struct track_iface, sock);
+
+	if (iface->method == METHOD_ARPING)
+		probe_recv_arp(iface);
+	else
+		probe_recv_ping(iface);
+
+	if (iface->in_round && round_complete(iface)) {
+		uloop_timeout_cancel(&iface->round_timer);
+		round_finish(iface);
+	}
+}
+
+static void
+probe_send(struct uloop_timeout *timeout)
+{
+	struct track_iface *iface = container_of(timeout, struct track_iface, probe_timer);
+	int i;
+
+	for (i = 0; i < iface->n_targets; i++) {
+		if (!iface->targets[i].resolved)
+			continue;
+
+		if (iface->method == METHOD_ARPING)
+			send_arp(iface, i);
+		else
+			send_ping(iface, i);
+	}
+
+	if (++iface->probe_idx < iface->count)
+		uloop_timeout_set(&iface->probe_timer, PROBE_SPACING);
+}
+
+static void
+round_timeout(struct uloop_timeout *timeout)
+{
+	struct track_iface *iface = container_of(timeout, struct track_iface, round_timer);
+
+	if (iface->in_round)
+		round_finish(iface);
+	else if (iface->started)
+		round_start(iface);
+}
+
+static void
+round_start(struct track_iface *iface)
+{
+	struct track_target *t;
+	int i;
+
+	resolve_targets(iface);
+
+	iface->round++;
+	iface->probe_idx = 0;
+	iface->in_round = true;
+
+	for (i = 0; i < iface->n_targets; i++) {
+		t = &iface->targets[i];
+		t->sent = t->received = 0;
+		t->rtt_sum = 0;
+	}
+
+	if (iface->sock.fd < 0 && !sock_open(iface)) {
+		/* nothing could be sent, score the round as failed */
+		uloop_timeout_set(&iface->round_timer, iface->timeout * 1000);
+		return;
+	}
+
+	probe_send(&iface->probe_timer);
+	uloop_timeout_set(&iface->round_timer,
+			  (iface->count - 1) * PROBE_SPACING + iface->timeout * 1000);
+}
+
+static void
+round_schedule(struct track_iface *iface, int secs)
+{
+	uloop_timeout_cancel(&iface->probe_timer);
+	iface->in_round = false;
+
+	if (iface->started)
+		uloop_timeout_set(&iface->round_timer, secs * 1000);
+	else
+		uloop_timeout_cancel(&iface->round_timer);
+}
+
+/* port of the per target checks and the score keeping of mwan3track's main loop */
+static void
+round_finish(struct track_iface *iface)
+{
+	int sleep_time = iface->interval;
+	struct track_target *t;
+	const char *do_log;
+	bool ok;
+	int i;
+
+	uloop_timeout_cancel(&iface->probe_timer);
+	iface->in_round = false;
+
+	for (i = 0; i < iface->n_targets; i++) {
+		t = &iface->targets[i];
+		t->total_sent += t->sent;
+
+		if (iface->host_up_count >= iface->reliability) {
+			t->state = "skipped";
+			write_target_status(iface, t, false);
+			continue;
+		}
+
+		do_log = NULL;
+
+		if (!iface->check_quality) {
+			ok = t->received > 0;
+
+			if (ok) {
+				iface->host_up_count++;
+				t->state = "up";
+				if (iface->score <= iface->up)
+					do_log = "success";
+			} else {
+				iface->lost++;
+				t->state = "down";
+				if (iface->score > iface->up)
+					do_log = "failed";
+			}
+
+			write_target_status(iface, t, false);
+
+			if (do_log)
+				LOG(LOG_INFO, "Check (%s) %s for target \"%s\" on interface %s (%s). Current score: %d",
+				    method_names[iface->method], do_log, t->host, iface->name,
+				    iface->device, iface->score);
+			continue;
+		}
+
+		if (t->received) {
+			t->loss = (t->sent - t->received) * 100 / t->sent;
+			t->latency = t->rtt_sum / t->received / 1000;
+		} else {
+			t->loss = 100;
+			t->latency = 999999;
+		}
+
+		if (t->loss >= iface->failure_loss || t->latency >= iface->failure_latency) {
+			iface->lost++;
+			t->state = "down";
+			if (iface->score > iface->up)
+				do_log = "failed";
+		} else if (t->loss <= iface->recovery_loss && t->latency <= iface->recovery_latency) {
+			iface->host_up_count++;
+			t->state = "up";
+			if (iface->score <= iface->up)
+				do_log = "success";
+		} else {
+			t->state = "skipped";
+			write_target_status(iface, t, false);
+			continue;
+		}
+
+		write_target_status(iface, t, true);
+
+		if (do_log)
+			LOG(LOG_INFO, "Check (%s: latency=%dms loss=%d%%) %s for target \"%s\" on interface %s (%s). Current score: %d",
+			    method_names[iface->method], t->latency, t->loss, do_log, t->host,
+			    iface->name, iface->device, iface->score);
+	}
+
+	if (iface->host_up_count < iface->reliability) {
+		iface->score--;
+
+		if (iface->score < iface->up) {
+			iface->score = 0;
+			if (iface->keep_failure_interval)
+				sleep_time = iface->failure_interval;
+		} else {
+			iface_set_transient(iface, "disconnecting", "disconnecting");
+			sleep_time = iface->failure_interval;
+		}
+
+		if (iface->score == iface->up) {
+			iface_disconnected(iface, false);
+			iface->score = 0;
+		}
+	} else {
+		if (iface->score < iface->down + iface->up && iface->lost > 0) {
+			iface_set_transient(iface, "connecting", "connecting");
+			LOG(LOG_INFO, "Lost %d ping(s) on interface %s (%s). Current score: %d",
+			    iface->lost * iface->count, iface->name, iface->device, iface->score);
+		}
+
+		iface->score++;
+		iface->lost = 0;
+
+		if (iface->score > iface->up) {
+			write_status(iface, "STATUS", "online");
+			iface->score = iface->down + iface->up;
+		} else {
+			iface_set_transient(iface, "connecting", "connecting");
+			sleep_time = iface->recovery_interval;
+		}
+
+		if (iface->score == iface->up)
+			iface_connected(iface, false);
+	}
+
+	iface->turn++;
+	write_status(iface, "LOST", "%d", iface->lost);
+	write_status(iface, "SCORE", "%d", iface->score);
+	write_status(iface, "TURN", "%d", iface->turn);
+	write_status(iface, "CONDITION_ID", "%s", iface->cond);
+	write_status(iface, "TIME", "%ld", get_uptime());
+
+	iface->host_up_count = 0;
+	round_schedule(iface, sleep_time);
+}
+
+static void
+iface_firstconnect(struct track_iface *iface)
+{
+	send_event(iface, "started");
+
+	sock_close(iface);
+
+	if (!iface->status || strcmp(iface->status, "online"))
+		iface->status = iface->initial_state;
+
+	if (!resolve_iface(iface)) {
+		iface_disabled(iface);
+		round_schedule(iface, 0);
+		return;
+	}
+
+	LOG(LOG_DEBUG, "firstconnect: called on %s (%s). Status is %s",
+	    iface->name, iface->device, iface->status);
+
+	iface->started = true;
+
+	if (!strcmp(iface->status, "offline"))
+		iface_disconnected(iface, true);
+	else
+		iface_connected(iface, true);
+
+	round_schedule(iface, 0);
+}
+
+static void
+iface_down(struct track_iface *iface)
+{
+	LOG(LOG_INFO, "Detect ifdown event on interface %s (%s)", iface->name, iface->device);
+
+	sock_close(iface);
+	iface_disconnected(iface, false);
+	iface_disabled(iface);
+	round_schedule(iface, 0);
+}
+
+
+/* configuration */
+
+static const char *
+uci_get(struct uci_section *s, const char *opt, const char *def)
+{
+	const char *v = s ? uci_lookup_option_string(s->package->ctx, s, opt) : NULL;
+
+	return v ? v : def;
+}
+
+static int
+uci_get_int(struct uci_section *s, const char *opt, int def)
+{
+	const char *v = uci_get(s, opt, NULL);
+
+	return v ? atoi(v) : def;
+}
+
+static int
+uci_get_bool(struct uci_section *s, const char *opt, int def)
+{
+	const char *v = uci_get(s, opt, NULL);
+
+	if (!v)
+		return def;
+
+	return !strcmp(v, "1") || !strcmp(v, "on") || !strcmp(v, "true") ||
+	       !strcmp(v, "yes") || !strcmp(v, "enabled");
+}
+
+static struct uci_section *
+find_condition(struct uci_package *p, const char *iface)
+{
+	struct uci_element *e;
+	struct uci_section *s;
+
+	uci_foreach_element(&p->sections, e) {
+		s = uci_to_section(e);
+
+		if (!strcmp(s->type, "condition") &&
+		    !strcmp(uci_get(s, "interface", ""), iface))
+			return s;
+	}
+
+	return NULL;
+}
+
+static uint32_t
+read_fwmark(struct uci_package *p)
+{
+	struct uci_section *s = uci_lookup_section(p->ctx, p, "globals");
+	const char *mask = uci_get(s, "mmx_mask", "0x3F00");
+	char buf[32];
+	FILE *f;
+
+	/* mwan3_init caches the mask, MMX_DEFAULT is the full mask */
+	f = fopen(MWAN3_STATUS_DIR "/mmx_mask", "r");
+	if (f) {
+		if (fgets(buf, sizeof(buf), f))
+			mask = buf;
+		fclose(f);
+	}
+
+	return strtoul(mask, NULL, 0);
+}
+
+static struct track_iface *
+iface_load(struct uci_package *p, const char *name)
+{
+	struct uci_section *s = uci_lookup_section(p->ctx, p, name);
+	struct uci_section *c = find_condition(p, name);
+	struct track_iface *iface;
+	struct uci_option *o;
+	struct uci_element *e;
+	const char *method, *family;
+
+	if (!s || strcmp(s->type, "interface")) {
+		LOG(LOG_ERR, "Interface %s is not configured", name);
+		return NULL;
+	}
+
+	if (!c) {
+		LOG(LOG_ERR, "No condition configured for interface %s", name);
+		return NULL;
+	}
+
+	/* the init script leaves every other method to mwan3track */
+	method = uci_get(c, "track_method", "ping");
+	family = uci_get(s, "family", "ipv4");
+	if (strcmp(method, "ping") &&
+	    (strcmp(method, "arping") || !strcmp(family, "ipv6"))) {
+		LOG(LOG_ERR, "Track method %s is not supported for interface %s, "
+		    "it is left to mwan3track", method, name);
+		return NULL;
+	}
+
+	iface = calloc(1, sizeof(*iface));
+	if (!iface)
+		return NULL;
+
+	iface->name = strdup(name);
+	iface->cond = strdup(c->e.name);
+	iface->af = strcmp(family, "ipv6") ? AF_INET : AF_INET6;
+	iface->initial_state = strdup(uci_get(s, "initial_state", "online"));
+	iface->interval = uci_get_int(s, "interval", 10);
+
+	iface->method = strcmp(method, "arping") ? METHOD_PING : METHOD_ARPING;
+
+	iface->reliability = uci_get_int(c, "reliability", 1);
+	iface->count = uci_get_int(c, "count", 1);
+	iface->timeout = uci_get_int(c, "timeout", 4);
+	iface->down = uci_get_int(c, "down", 5);
+	iface->up = uci_get_int(c, "up", 5);
+	iface->size = uci_get_int(c, "size", 56);
+	iface->max_ttl = uci_get_int(c, "max_ttl", 60);
+	iface->failure_interval = uci_get_int(c, "failure_interval", iface->interval);
+	iface->keep_failure_interval = uci_get_bool(c, "keep_failure_interval", 0);
+	iface->recovery_interval = uci_get_int(c, "recovery_interval", iface->interval);
+	iface->check_quality = uci_get_bool(c, "check_quality", 0);
+	iface->failure_latency = uci_get_int(c, "failure_latency", 1000);
+	iface->recovery_latency = uci_get_int(c, "recovery_latency", 500);
+	iface->failure_loss = uci_get_int(c, "failure_loss", 40);
+	iface->recovery_loss = uci_get_int(c, "recovery_loss", 10);
+
+	if (iface->count < 1)
+		iface->count = 1;
+	else if (iface->count > MAX_COUNT)
+		iface->count = MAX_COUNT;
+
+	/* replies are matched on the payload, so it has to fit */
+	if (iface->size < (int)sizeof(struct probe_payload))
+		iface->size = sizeof(struct probe_payload);
+	else if (iface->size > 65507 - (int)sizeof(struct icmphdr))
+		iface->size = 56;
+
+	o = uci_lookup_option(c->package->ctx, c, "track_ip");
+	if (o && o->type == UCI_TYPE_LIST) {
+		uci_foreach_element(&o->v.list, e) {
+			if (iface->n_targets == MAX_TARGETS)
+				break;
+
+			iface->targets[iface->n_targets++].host = strdup(e->name);
+		}
+	} else if (o) {
+		iface->targets[iface->n_targets++].host = strdup(o->v.string);
+	}
+
+	iface->sock.fd = -1;
+	iface->score = iface->down + iface->up;
+	iface->probe_timer.cb = probe_send;
+	iface->round_timer.cb = round_timeout;
+
+	return iface;
+}
+
+
+/* ubus */
+
+enum {
+	IFACE_NAME,
+	__IFACE_MAX
+};
+
+static const struct blobmsg_policy iface_policy[__IFACE_MAX] = {
+	[IFACE_NAME] = { "interface", BLOBMSG_TYPE_STRING },
+};
+
+static struct track_iface *
+iface_find(struct blob_attr *msg, int *err)
+{
+	struct blob_attr *tb[__IFACE_MAX];
+	struct track_iface *iface;
+
+	blobmsg_parse(iface_policy, __IFACE_MAX, tb, blob_data(msg), blob_len(msg));
+
+	*err = UBUS_STATUS_INVALID_ARGUMENT;
+	if (!tb[IFACE_NAME])
+		return NULL;
+
+	*err = UBUS_STATUS_NOT_FOUND;
+	list_for_each_entry(iface, &ifaces, list)
+		if (!strcmp(iface->name, blobmsg_get_string(tb[IFACE_NAME])))
+			return iface;
+
+	return NULL;
+}
+
+static void
+dump_target(struct track_target *t)
+{
+	char bound[16];
+	unsigned int i;
+	void *c, *h;
+
+	c = blobmsg_open_table(&b, NULL);
+	blobmsg_add_string(&b, "ip", t->host);
+	blobmsg_add_string(&b, "state", t->state ? t->state : "unknown");
+	blobmsg_add_u32(&b, "latency", t->latency);
+	blobmsg_add_u32(&b, "loss", t->loss);
+	blobmsg_add_u32(&b, "last_rtt_us", t->last_rtt);
+	blobmsg_add_u32(&b, "jitter_us", t->jitter);
+	blobmsg_add_u64(&b, "sent", t->total_sent);
+	blobmsg_add_u64(&b, "received", t->total_received);
+
+	h = blobmsg_open_table(&b, "histogram");
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (i < ARRAY_SIZE(hist_bounds))
+			snprintf(bound, sizeof(bound), "%u", hist_bounds[i]);
+		else
+			snprintf(bound, sizeof(bound), "inf");
+
+		blobmsg_add_u32(&b, bound, t->hist[i]);
+	}
+	blobmsg_close_table(&b, h);
+
+	blobmsg_close_table(&b, c);
+}
+
+static void
+dump_iface(struct track_iface *iface)
+{
+	void *c, *a;
+	int i;
+
+	c = blobmsg_open_table(&b, iface->name);
+	blobmsg_add_string(&b, "status", iface->status ? iface->status : "unknown");
+	blobmsg_add_string(&b, "tracking", iface->started ? "active" : "paused");
+	blobmsg_add_string(&b, "method", method_names[iface->method]);
+	blobmsg_add_string(&b, "device", iface->device);
+	blobmsg_add_u32(&b, "score", iface->score);
+	blobmsg_add_u32(&b, "lost", iface->lost);
+	blobmsg_add_u32(&b, "turn", iface->turn);
+
+	a = blobmsg_open_array(&b, "track_ip");
+	for (i = 0; i < iface->n_targets; i++)
+		dump_target(&iface->targets[i]);
+	blobmsg_close_array(&b, a);
+
+	blobmsg_close_table(&b, c);
+}
+
+static int
+ubus_status(struct ubus_context *ctx, struct ubus_object *obj,
+	    struct ubus_request_data *req, const char *method,
+	    struct blob_attr *msg)
+{
+	struct track_iface *iface, *only = NULL;
+	int err;
+	void *c;
+
+	if (msg && blob_len(msg)) {
+		only = iface_find(msg, &err);
+		if (!only && err == UBUS_STATUS_NOT_FOUND)
+			return err;
+	}
+
+	blob_buf_init(&b, 0);
+	c = blobmsg_open_table(&b, "interfaces");
+
+	list_for_each_entry(iface, &ifaces, list)
+		if (!only || only == iface)
+			dump_iface(iface);
+
+	blobmsg_close_table(&b, c);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+static int
+ubus_ifup(struct ubus_context *ctx, struct ubus_object *obj,
+	  struct ubus_request_data *req, const char *method,
+	  struct blob_attr *msg)
+{
+	struct track_iface *iface;
+	int err;
+
+	if (!(iface = iface_find(msg, &err)))
+		return err;
+
+	LOG(LOG_INFO, "Detect ifup event on interface %s (%s)", iface->name, iface->device);
+	iface_firstconnect(iface);
+
+	return 0;
+}
+
+static int
+ubus_ifdown(struct ubus_context *ctx, struct ubus_object *obj,
+	    struct ubus_request_data *req, const char *method,
+	    struct blob_attr *msg)
+{
+	struct track_iface *iface;
+	int err;
+
+	if (!(iface = iface_find(msg, &err)))
+		return err;
+
+	iface_down(iface);
+
+	return 0;
+}
+
+static const struct ubus_method track_methods[] = {
+	UBUS_METHOD("status", ubus_status, iface_policy),
+	UBUS_METHOD("ifup", ubus_ifup, iface_policy),
+	UBUS_METHOD("ifdown", ubus_ifdown, iface_policy),
+};
+
+static struct ubus_object_type track_type =
+	UBUS_OBJECT_TYPE("mwan3track", track_methods);
+
+static struct ubus_object track_obj = {
+	.name = "mwan3track",
+	.type = &track_type,
+	.methods = track_methods,
+	.n_methods = ARRAY_SIZE(track_methods),
+};
+
+
+int
+main(int argc, char **argv)
+{
+	struct uci_context *uci;
+	struct uci_package *p = NULL;
+	struct track_iface *iface, *tmp;
+	char path[256];
+	int i;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <interface> [<interface> ...]\n", argv[0]);
+		return 1;
+	}
+
+	openlog("mwan3track", LOG_PID, LOG_DAEMON);
+
+	uci = uci_alloc_context();
+	if (!uci || uci_load(uci, "mwan3", &p)) {
+		LOG(LOG_ERR, "Unable to load mwan3 configuration");
+		return 1;
+	}
+
+	fwmark = read_fwmark(p);
+
+	for (i = 1; i < argc; i++) {
+		iface = iface_load(p, argv[i]);
+		if (!iface)
+			continue;
+
+		iface->ident = (getpid() + i) & 0xffff;
+		list_add_tail(&iface->list, &ifaces);
+
+		snprintf(path, sizeof(path), MWAN3TRACK_STATUS_DIR "/%s", iface->name);
+		mkdir(MWAN3TRACK_STATUS_DIR, 0755);
+		mkdir(path, 0755);
+	}
+
+	uci_free_context(uci);
+
+	if (list_empty(&ifaces))
+		return 1;
+
+	uloop_init();
+
+	ubus_ctx = ubus_connect(NULL);
+	if (!ubus_ctx) {
+		LOG(LOG_ERR, "Unable to connect to ubus");
+		return 1;
+	}
+
+	ubus_add_uloop(ubus_ctx);
+
+	if (ubus_add_object(ubus_ctx, &track_obj))
+		LOG(LOG_ERR, "Unable to register ubus object");
+
+	list_for_each_entry(iface, &ifaces, list)
+		iface_firstconnect(iface);
+
+	uloop_run();
+
+	list_for_each_entry_safe(iface, tmp, &ifaces, list) {
+		LOG(LOG_NOTICE, "Stopping mwan3track for interface \"%s\". Status was \"%s\"",
+		    iface->name, iface->status ? iface->status : "");
+		send_event(iface, "stopped");
+		sock_close(iface);
+	}
+
+	ubus_free(ubus_ctx);
+	uloop_done();
+
+	return 0;
+}
@@ -0,0 +1,416 @@
+/*
+ * mtd-delta - apply delta firmware images
+ *
+ * A delta image describes the new contents of one or more partitions as
+ * a list of operations against their current contents: copy a range of
+ * the old partition, or insert literal data from the delta image. The
+ * result is streamed to stdout, so it can be piped into mtd write or
+ * ubiupdatevol without holding the new image in memory, and checked
+ * against the sha256 hash of the new contents on the way.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License v2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define _GNU_SOURCE
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sha256.h"
+
+#define DELTA_MAGIC		"MDLT"
+#define DELTA_VERSION		1
+
+#define DELTA_OP_COPY		0
+#define DELTA_OP_DATA		1
+
+#define DELTA_BUFLEN		(64 * 1024)
+
+/* All fields are little endian */
+struct delta_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t sections;
+	uint32_t reserved;
+} __attribute__((packed));
+
+/* Followed by 'ops' operations, data operations by their literal data */
+struct delta_section {
+	char name[32];
+	uint64_t old_size;
+	uint64_t new_size;
+	uint8_t old_sha256[32];
+	uint8_t new_sha256[32];
+	uint32_t ops;
+	uint32_t reserved;
+} __attribute__((packed));
+
+struct delta_op {
+	uint32_t type;
+	uint32_t len;
+	uint64_t src;
+} __attribute__((packed));
+
+static char buf[DELTA_BUFLEN];
+static sha256_ctx_t out_hash;
+
+static int
+read_exact(FILE *f, void *data, size_t len)
+{
+	if (fread(data, 1, len, f) != len) {
+		fprintf(stderr, "Truncated delta image\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+write_exact(int fd, const char *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, data, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "Write failed: %s\n", strerror(errno));
+			return -1;
+		}
+		data += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int
+emit(const char *data, size_t len)
+{
+	sha256_hash(&out_hash, data, len);
+	return write_exact(STDOUT_FILENO, data, len);
+}
+
+static int
+read_section(FILE *f, struct delta_section *s)
+{
+	if (read_exact(f, s, sizeof(*s)))
+		return -1;
+
+	s->name[sizeof(s->name) - 1] = 0;
+	s->old_size = le64toh(s->old_size);
+	s->new_size = le64toh(s->new_size);
+	s->ops = le32toh(s->ops);
+
+	return 0;
+}
+
+static int
+read_op(FILE *f, struct delta_op *op)
+{
+	if (read_exact(f, op, sizeof(*op)))
+		return -1;
+
+	op->type = le32toh(op->type);
+	op->len = le32toh(op->len);
+	op->src = le64toh(op->src);
+
+	return 0;
+}
+
+/*
+ * Check the operations of the section at the current position and leave the
+ * file positioned after them. With in_place set, copies may only read data
+ * at or behind the position they are written to, so the old contents can be
+ * overwritten while the section is applied.
+ */
+static int
+check_section(FILE *f, const struct delta_section *s, bool in_place)
+{
+	struct delta_op op;
+	uint64_t pos = 0;
+	uint32_t i;
+
+	for (i = 0; i < s->ops; i++) {
+		if (read_op(f, &op))
+			return -1;
+
+		switch (op.type) {
+		case DELTA_OP_COPY:
+			if (op.src > s->old_size || op.len > s->old_size - op.src) {
+				fprintf(stderr, "%s: copy beyond the old contents\n", s->name);
+				return -1;
+			}
+			if (in_place && op.src < pos) {
+				fprintf(stderr, "%s: cannot be applied in place\n", s->name);
+				return -1;
+			}
+			break;
+		case DELTA_OP_DATA:
+			if (fseeko(f, op.len, SEEK_CUR)) {
+				fprintf(stderr, "Truncated delta image\n");
+				return -1;
+			}
+			break;
+		default:
+			fprintf(stderr, "%s: unknown operation %" PRIu32 "\n", s->name, op.type);
+			return -1;
+		}
+
+		pos += op.len;
+	}
+
+	if (pos != s->new_size) {
+		fprintf(stderr, "%s: operations do not add up to the new size\n", s->name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static FILE *
+open_delta(const char *file, uint32_t *sections)
+{
+	struct delta_header h;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f) {
+		fprintf(stderr, "Could not open %s: %s\n", file, strerror(errno));
+		return NULL;
+	}
+
+	if (read_exact(f, &h, sizeof(h)))
+		goto error;
+
+	if (memcmp(h.magic, DELTA_MAGIC, sizeof(h.magic)) != 0) {
+		fprintf(stderr, "%s: not a delta image\n", file);
+		goto error;
+	}
+
+	if (le32toh(h.version) != DELTA_VERSION) {
+		fprintf(stderr, "%s: unsupported delta version %" PRIu32 "\n", file, le32toh(h.version));
+		goto error;
+	}
+
+	*sections = le32toh(h.sections);
+	return f;
+
+error:
+	fclose(f);
+	return NULL;
+}
+
+static void
+print_hex(const uint8_t *data, size_t len)
+{
+	while (len--)
+		printf("%02x", *data++);
+}
+
+/* Print one line per section: name, old size and hash, new size and hash */
+static int
+delta_info(const char *file)
+{
+	struct delta_section s;
+	uint32_t sections, i;
+	FILE *f;
+
+	f = open_delta(file, &sections);
+	if (!f)
+		return 1;
+
+	for (i = 0; i < sections; i++) {
+		if (read_section(f, &s) || check_section(f, &s, false))
+			goto error;
+
+		printf("%s %" PRIu64 " ", s.name, s.old_size);
+		print_hex(s.old_sha256, sizeof(s.old_sha256));
+		printf(" %" PRIu64 " ", s.new_size);
+		print_hex(s.new_sha256, sizeof(s.new_sha256));
+		printf("\n");
+	}
+
+	fclose(f);
+	return 0;
+
+error:
+	fclose(f);
+	return 1;
+}
+
+static int
+copy_old(int fd, uint64_t src, uint32_t len)
+{
+	ssize_t ret;
+	size_t n;
+
+	while (len > 0) {
+		n = len < sizeof(buf) ? len : sizeof(buf);
+		ret = pread(fd, buf, n, src);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "Could not read old contents at 0x%" PRIx64 "\n", src);
+			return -1;
+		}
+		if (emit(buf, ret))
+			return -1;
+		src += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int
+copy_data(FILE *f, uint32_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		n = len < sizeof(buf) ? len : sizeof(buf);
+		if (read_exact(f, buf, n) || emit(buf, n))
+			return -1;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Write the new contents of a section to stdout. Fails after writing them if
+ * they do not match the hash in the section header.
+ */
+static int
+delta_apply(const char *file, const char *name, const char *old, bool in_place)
+{
+	struct delta_section s;
+	struct delta_op op;
+	uint8_t digest[SHA256_DIGEST_LENGTH];
+	uint32_t sections, i;
+	bool found = false;
+	off_t start = 0;
+	int fd = -1;
+	FILE *f;
+
+	f = open_delta(file, &sections);
+	if (!f)
+		return 1;
+
+	for (i = 0; i < sections; i++) {
+		if (read_section(f, &s))
+			goto error;
+
+		start = ftello(f);
+		found = !strcmp(s.name, name);
+		if (check_section(f, &s, in_place && found))
+			goto error;
+
+		if (found)
+			break;
+	}
+
+	if (!found) {
+		fprintf(stderr, "%s: no section '%s'\n", file, name);
+		goto error;
+	}
+
+	if (s.old_size > 0) {
+		if (!old) {
+			fprintf(stderr, "%s: the old contents are needed\n", name);
+			goto error;
+		}
+
+		fd = open(old, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Could not open %s: %s\n", old, strerror(errno));
+			goto error;
+		}
+	}
+
+	fseeko(f, start, SEEK_SET);
+	sha256_begin(&out_hash);
+	for (i = 0; i < s.ops; i++) {
+		if (read_op(f, &op))
+			goto error;
+
+		if (op.type == DELTA_OP_COPY) {
+			if (copy_old(fd, op.src, op.len))
+				goto error;
+		} else if (copy_data(f, op.len)) {
+			goto error;
+		}
+	}
+
+	sha256_end(&out_hash, digest);
+	if (memcmp(digest, s.new_sha256, sizeof(digest)) != 0) {
+		fprintf(stderr, "%s: new contents do not match the delta image\n", name);
+		goto error;
+	}
+
+	if (fd >= 0)
+		close(fd);
+	fclose(f);
+	return 0;
+
+error:
+	if (fd >= 0)
+		close(fd);
+	fclose(f);
+	return 1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: mtd-delta <command> [<arguments> ...]\n\n"
+	"mtd-delta recognizes these commands:\n"
+	"        info <delta>            list the sections of a delta image\n"
+	"        apply [-i] <delta> <section> [<old>]\n"
+	"                                write the new contents of a section to stdout,\n"
+	"                                reading the old contents from file or device <old>\n"
+	"Options for apply:\n"
+	"        -i                      refuse sections that cannot be written back\n"
+	"                                to <old> while they are applied\n"
+	"\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	bool in_place = false;
+
+	if (argc == 3 && !strcmp(argv[1], "info"))
+		return delta_info(argv[2]);
+
+	if (argc < 2 || strcmp(argv[1], "apply") != 0)
+		usage();
+
+	argc -= 2;
+	argv += 2;
+
+	if (argc > 0 && !strcmp(argv[0], "-i")) {
+		in_place = true;
+		argc--;
+		argv++;
+	}
+
+	if (argc < 2 || argc > 3)
+		usage();
+
+	return delta_apply(argv[0], argv[1], argc == 3 ? argv[2] : NULL, in_place);
+}
@@ -0,0 +1,114 @@
+/*
+ * SHA-256 as specified in FIPS 180-4
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License v2
+ * as published by the Free Software Foundation.
+ */
+
+#include <string.h>
+#include "sha256.h"
+
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void sha256_transform(uint32_t *state, const uint8_t *data)
+{
+	uint32_t W[64], S[8], t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		W[i] = (uint32_t)data[i * 4] << 24 | (uint32_t)data[i * 4 + 1] << 16 |
+		       (uint32_t)data[i * 4 + 2] << 8 | data[i * 4 + 3];
+
+	for (i = 16; i < 64; i++)
+		W[i] = (ROR(W[i - 2], 17) ^ ROR(W[i - 2], 19) ^ (W[i - 2] >> 10)) + W[i - 7] +
+		       (ROR(W[i - 15], 7) ^ ROR(W[i - 15], 18) ^ (W[i - 15] >> 3)) + W[i - 16];
+
+	memcpy(S, state, sizeof(S));
+
+	for (i = 0; i < 64; i++) {
+		t1 = S[7] + (ROR(S[4], 6) ^ ROR(S[4], 11) ^ ROR(S[4], 25)) +
+		     ((S[4] & S[5]) ^ (~S[4] & S[6])) + K[i] + W[i];
+		t2 = (ROR(S[0], 2) ^ ROR(S[0], 13) ^ ROR(S[0], 22)) +
+		     ((S[0] & S[1]) ^ (S[0] & S[2]) ^ (S[1] & S[2]));
+		memmove(&S[1], &S[0], 7 * sizeof(S[0]));
+		S[4] += t1;
+		S[0] = t1 + t2;
+	}
+
+	for (i = 0; i < 8; i++)
+		state[i] += S[i];
+}
+
+void sha256_begin(sha256_ctx_t *ctx)
+{
+	static const uint32_t init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(ctx->state, init, sizeof(init));
+	ctx->count = 0;
+}
+
+void sha256_hash(sha256_ctx_t *ctx, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	size_t used = ctx->count % 64;
+	size_t n;
+
+	ctx->count += len;
+
+	if (used) {
+		n = 64 - used < len ? 64 - used : len;
+		memcpy(ctx->buf + used, p, n);
+		p += n;
+		len -= n;
+		if (used + n < 64)
+			return;
+		sha256_transform(ctx->state, ctx->buf);
+	}
+
+	for (; len >= 64; p += 64, len -= 64)
+		sha256_transform(ctx->state, p);
+
+	memcpy(ctx->buf, p, len);
+}
+
+void sha256_end(sha256_ctx_t *ctx, uint8_t *digest)
+{
+	uint64_t bits = ctx->count * 8;
+	uint8_t pad[72] = { 0x80 };
+	size_t padlen = 64 - (ctx->count + 8) % 64;
+	int i;
+
+	for (i = 0; i < 8; i++)
+		pad[padlen + i] = bits >> (56 - i * 8);
+	sha256_hash(ctx, pad, padlen + 8);
+
+	for (i = 0; i < 8; i++) {
+		digest[i * 4] = ctx->state[i] >> 24;
+		digest[i * 4 + 1] = ctx->state[i] >> 16;
+		digest[i * 4 + 2] = ctx->state[i] >> 8;
+		digest[i * 4 + 3] = ctx->state[i];
+	}
+}
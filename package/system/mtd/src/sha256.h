@@ -0,0 +1,19 @@
+#ifndef __SHA256_H
+#define __SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LENGTH	32
+
+typedef struct {
+	uint32_t state[8];
+	uint64_t count;
+	uint8_t buf[64];
+} sha256_ctx_t;
+
+void sha256_begin(sha256_ctx_t *ctx);
+void sha256_hash(sha256_ctx_t *ctx, const void *data, size_t len);
+void sha256_end(sha256_ctx_t *ctx, uint8_t *digest);
+
+#endif /* __SHA256_H */
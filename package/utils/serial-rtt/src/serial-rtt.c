@@ -0,0 +1,352 @@
+/*
+ * serial-rtt - measure request/response turnaround over serial ports
+ *
+ * With one port a loopback plug (TX shorted to RX) is expected and every
+ * frame written is timed until it has been read back completely. With two
+ * ports a child process answers on the second one, echoing each frame as
+ * soon as it has been received, which is what a polled slave on the other
+ * end of a link does.
+ *
+ * Besides the turnaround the largest gap between two consecutive reads of
+ * the same frame is reported. Protocols like Modbus RTU treat a gap longer
+ * than 1.5 character times as end of frame, so a driver that delivers data
+ * in bursts breaks them even when the average latency looks fine.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <linux/serial.h>
+
+#define MAX_FRAME 4096
+
+static const struct {
+	unsigned int rate;
+	speed_t speed;
+} bauds[] = {
+	{ 1200, B1200 },     { 2400, B2400 },     { 4800, B4800 },
+	{ 9600, B9600 },     { 19200, B19200 },   { 38400, B38400 },
+	{ 57600, B57600 },   { 115200, B115200 }, { 230400, B230400 },
+	{ 460800, B460800 }, { 921600, B921600 }, { 1000000, B1000000 },
+	{ 2000000, B2000000 }, { 3000000, B3000000 },
+};
+
+static unsigned int baud = 115200;
+static unsigned int count = 1000;
+static unsigned int size = 8;
+static unsigned int interval_ms = 10;
+static unsigned int timeout_ms = 1000;
+static int low_latency;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int port_open(const char *path)
+{
+	struct serial_struct ss;
+	struct termios tio;
+	speed_t speed = 0;
+	size_t i;
+	int fd;
+
+	for (i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++) {
+		if (bauds[i].rate == baud)
+			speed = bauds[i].speed;
+	}
+
+	if (!speed) {
+		fprintf(stderr, "Unsupported baud rate %u\n", baud);
+		return -1;
+	}
+
+	fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (tcgetattr(fd, &tio)) {
+		fprintf(stderr, "%s is not a tty: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CRTSCTS | CSTOPB);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	if (tcsetattr(fd, TCSANOW, &tio)) {
+		fprintf(stderr, "Unable to configure %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* drivers that have a latency timer (ftdi_sio) map this flag onto it */
+	if (low_latency && !ioctl(fd, TIOCGSERIAL, &ss)) {
+		ss.flags |= ASYNC_LOW_LATENCY;
+		if (ioctl(fd, TIOCSSERIAL, &ss))
+			fprintf(stderr, "Unable to set low latency on %s: %s\n",
+			        path, strerror(errno));
+	}
+
+	tcflush(fd, TCIOFLUSH);
+
+	return fd;
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				return -1;
+			if (poll(&pfd, 1, timeout_ms) <= 0)
+				return -1;
+			continue;
+		}
+
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Read exactly len bytes. The first byte may take up to timeout_ms, after
+ * that the frame has to keep coming. The largest gap between two reads that
+ * returned data is stored in *gap.
+ */
+static int read_frame(int fd, uint8_t *buf, size_t len, uint64_t *gap)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint64_t last = 0, t;
+	size_t got = 0;
+	ssize_t n;
+
+	*gap = 0;
+
+	while (got < len) {
+		n = poll(&pfd, 1, timeout_ms);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+
+		n = read(fd, buf + got, len - got);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			continue;
+
+		t = now_us();
+		if (last && t - last > *gap)
+			*gap = t - last;
+		last = t;
+		got += n;
+	}
+
+	return 0;
+}
+
+static void responder(int fd)
+{
+	uint8_t buf[MAX_FRAME];
+	uint64_t gap;
+
+	for (;;) {
+		if (read_frame(fd, buf, size, &gap))
+			continue;
+		if (write_all(fd, buf, size))
+			break;
+	}
+
+	_exit(1);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+	        "Usage: %s [options] <port> [<peer port>]\n"
+	        "\n"
+	        "With a single port a TX to RX loopback is expected, with two\n"
+	        "ports the second one echoes every frame back.\n"
+	        "\n"
+	        "  -b <baud>      Baud rate (default %u)\n"
+	        "  -n <count>     Number of frames (default %u)\n"
+	        "  -s <size>      Frame size in bytes (default %u)\n"
+	        "  -i <ms>        Pause between frames (default %u)\n"
+	        "  -t <ms>        Response timeout (default %u)\n"
+	        "  -L             Request ASYNC_LOW_LATENCY on the ports\n",
+	        prog, baud, count, size, interval_ms, timeout_ms);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t tx[MAX_FRAME], rx[MAX_FRAME];
+	uint64_t *rtt, gap, max_gap = 0, sum = 0, t;
+	unsigned int i, j, done = 0, lost = 0, corrupt = 0;
+	double char_us;
+	pid_t child = -1;
+	int fd, peer = -1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:n:s:i:t:L")) != -1) {
+		switch (opt) {
+		case 'b':
+			baud = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 10);
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			timeout_ms = strtoul(optarg, NULL, 10);
+			break;
+		case 'L':
+			low_latency = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc || argc - optind > 2 || !count ||
+	    !size || size > MAX_FRAME) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fd = port_open(argv[optind]);
+	if (fd < 0)
+		return 1;
+
+	if (argc - optind == 2) {
+		peer = port_open(argv[optind + 1]);
+		if (peer < 0)
+			return 1;
+
+		child = fork();
+		if (child < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (child == 0) {
+			close(fd);
+			responder(peer);
+		}
+		close(peer);
+	}
+
+	rtt = calloc(count, sizeof(*rtt));
+	if (!rtt) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < size; j++)
+			tx[j] = (uint8_t)(i + j);
+
+		t = now_us();
+		if (write_all(fd, tx, size)) {
+			fprintf(stderr, "Write failed: %s\n", strerror(errno));
+			break;
+		}
+
+		if (read_frame(fd, rx, size, &gap)) {
+			lost++;
+			tcflush(fd, TCIOFLUSH);
+			continue;
+		}
+
+		if (memcmp(tx, rx, size)) {
+			corrupt++;
+			tcflush(fd, TCIOFLUSH);
+			continue;
+		}
+
+		rtt[done] = now_us() - t;
+		sum += rtt[done];
+		done++;
+
+		if (gap > max_gap)
+			max_gap = gap;
+
+		if (interval_ms)
+			usleep(interval_ms * 1000);
+	}
+
+	if (child > 0) {
+		kill(child, SIGTERM);
+		waitpid(child, NULL, 0);
+	}
+
+	/* start, 8 data and stop bit */
+	char_us = 10.0 * 1000000 / baud;
+
+	printf("frames:   %u sent, %u ok, %u lost, %u corrupt\n",
+	       i, done, lost, corrupt);
+	printf("wire:     %.0f us per frame each way\n", char_us * size);
+
+	if (done) {
+		qsort(rtt, done, sizeof(*rtt), cmp_u64);
+		printf("rtt (us): min %llu avg %llu p50 %llu p99 %llu max %llu\n",
+		       (unsigned long long)rtt[0],
+		       (unsigned long long)(sum / done),
+		       (unsigned long long)rtt[done / 2],
+		       (unsigned long long)rtt[(done * 99) / 100],
+		       (unsigned long long)rtt[done - 1]);
+		printf("max gap:  %llu us (%.1f character times)\n",
+		       (unsigned long long)max_gap, max_gap / char_us);
+	}
+
+	free(rtt);
+	close(fd);
+
+	return (lost || corrupt) ? 2 : 0;
+}
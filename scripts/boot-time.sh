@@ -0,0 +1,77 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Measure the time from kernel start to "- init complete -".
+#
+# Without arguments, run on a device and print the time of the current
+# boot. Given an ssh destination, reboot that device <count> times and
+# print the time of every boot and the minimum, average and maximum, to
+# compare images with and without an optimization:
+#
+#   scripts/boot-time.sh [-n <count>] root@192.168.1.1
+#
+# The ssh command can be overridden with the SSH environment variable.
+
+boot_time() {
+	dmesg | sed -n 's/^\[ *\([0-9.]*\)\].*- init complete -.*/\1/p' | head -n 1
+}
+
+if [ $# -eq 0 ]; then
+	time=$(boot_time)
+	if [ -z "$time" ]; then
+		echo "init has not completed yet" >&2
+		exit 1
+	fi
+	echo "$time"
+	exit 0
+fi
+
+count=5
+if [ "$1" = "-n" ]; then
+	count="$2"
+	shift 2
+fi
+host="$1"
+if [ -z "$host" ] || ! [ "$count" -gt 0 ] 2>/dev/null; then
+	echo "Usage: $0 [-n <count>] <ssh destination>" >&2
+	exit 1
+fi
+
+SSH="${SSH:-ssh -o ConnectTimeout=5 -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR}"
+remote_time="dmesg | sed -n 's/^\[ *\([0-9.]*\)\].*- init complete -.*/\1/p' | head -n 1"
+
+times=
+i=0
+while [ "$i" -lt "$count" ]; do
+	i=$((i + 1))
+	$SSH "$host" "rm -f /var/run/init-done; reboot" >/dev/null 2>&1
+
+	# Wait for the device to go down and come back with init done
+	sleep 10
+	tries=0
+	until $SSH "$host" "[ -e /var/run/init-done ]" >/dev/null 2>&1; do
+		tries=$((tries + 1))
+		if [ "$tries" -gt 60 ]; then
+			echo "$host did not come back" >&2
+			exit 1
+		fi
+		sleep 5
+	done
+
+	time=$($SSH "$host" "$remote_time")
+	if [ -z "$time" ]; then
+		echo "boot $i: no init complete message" >&2
+		continue
+	fi
+	echo "boot $i: $time s"
+	times="$times $time"
+done
+
+[ -n "$times" ] || exit 1
+echo "$times" | tr ' ' '\n' | awk 'NF {
+	n++; sum += $1
+	if (n == 1 || $1 < min) min = $1
+	if ($1 > max) max = $1
+} END {
+	printf "min %.3f s, avg %.3f s, max %.3f s over %d boots\n", min, sum / n, max, n
+}'
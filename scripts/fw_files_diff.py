@@ -2,6 +2,7 @@
 from __future__ import annotations
 
 import argparse
+import json
 import logging
 import re
 from os import get_terminal_size, getenv
@@ -9,8 +10,9 @@ from pathlib import Path
 from shlex import quote
 from subprocess import PIPE, Popen, run
 from sys import exit as sys_exit
-from sys import stderr
+from sys import stderr, stdout
 
+import squashfs_diff
 from sqlalchemy import Column, Enum, ForeignKey, Integer, String, create_engine, func, or_
 from sqlalchemy.orm import Session, aliased, declarative_base, sessionmaker
 
@@ -784,6 +786,25 @@ def collect_files(root_dir: str, file_list_type: str) -> str:
     )
 
 
+def collect_image_files(image_path: str) -> str:
+    """Collect file statistics straight from a squashfs image, in the format of 'du --all --bytes .'.
+
+    Args:
+        image_path (str): The squashfs image.
+
+    Returns:
+        str: The collected file statistics.
+
+    """
+    image = squashfs_diff.SquashfsImage(image_path)
+    try:
+        lines = [f"{size}\t.{path if path != '/' else ''}" for size, path, _ in squashfs_diff.du_lines(image)]
+    finally:
+        image.close()
+
+    return f"{Path(image_path).stat().st_size}\t{Path(image_path).name}\n" + "\n".join(lines) + "\n"
+
+
 def drop_vuci_suffix(filename: str) -> str:
     """Drop the VUCI suffix from the filename.
 
@@ -807,7 +828,12 @@ def save(args: object, db: Database, files_type: Database.FileTypes) -> None:
 
     """
     root_dir = quote(args.info_path)
-    if Path(root_dir).is_file():
+    if squashfs_diff.is_squashfs(args.info_path):
+        try:
+            files_stats = collect_image_files(args.info_path)
+        except squashfs_diff.SquashfsError as e:
+            exit_w_err(str(e))
+    elif Path(root_dir).is_file():
         with Path(root_dir).open() as file:
             files_stats = file.read()
     elif Path(root_dir).is_dir():
@@ -866,6 +892,22 @@ def list_versions(args: object, db: Database, files_type: Database.FileTypes) ->
         exit_w_err(str(e))
 
 
+def image_diff(args: object) -> None:
+    """Compare the contents of two squashfs images and print the differences as JSON.
+
+    Args:
+        args (object): The arguments object.
+
+    """
+    try:
+        result = squashfs_diff.diff_images(args.old_image, args.new_image, args.jobs, args.delta)
+    except (OSError, squashfs_diff.SquashfsError) as e:
+        exit_w_err(str(e))
+
+    json.dump(result, stdout, indent=2)
+    stdout.write("\n")
+
+
 def getenv_or_default(env_variable: str) -> str:
     """Retrieve the value of an environment variable or return a default value.
 
@@ -1005,10 +1047,21 @@ def parse_args() -> object:
     )
     parser_save.add_argument(
         "info_path",
-        help="A root directory of the file tree to save, like build_dir/target-*/root-*",
+        help="A root directory of the file tree to save, like build_dir/target-*/root-*, or a root.squashfs image",
     )
     parser_save.set_defaults(func=save)
 
+    parser_image_diff = subparsers.add_parser(
+        "image-diff",
+        aliases=["i"],
+        help="Compare the files of two squashfs images directly, without the database",
+    )
+    parser_image_diff.add_argument("-j", "--jobs", type=int, help="Number of files hashed in parallel (default - number of CPUs)")
+    parser_image_diff.add_argument("-d", "--delta", help="Also write a block-level delta to DELTA.json and DELTA.bin")
+    parser_image_diff.add_argument("old_image", help="Old root.squashfs")
+    parser_image_diff.add_argument("new_image", help="New root.squashfs")
+    parser_image_diff.set_defaults(func=image_diff)
+
     parser_list = subparsers.add_parser("list", aliases=["l"], help="List versions available for branch")
     parser_list.add_argument(
         "branch",
@@ -1022,6 +1075,10 @@ def parse_args() -> object:
 def main() -> None:
     """Parse arguments and execute the appropriate action."""
     args = parse_args()
+    if args.func is image_diff:
+        args.func(args)
+        return
+
     db = Database(*[getenv_or_default("ROM_DIFF_" + env_var) for env_var in ["DB_USER", "DB_PASSWORD", "DB_HOST", "DB_PORT", "DB_NAME"]])
 
     if args.gpl:
@@ -1,5 +1,55 @@
 #!/usr/bin/env bash
-set -e
+set -e -o pipefail
+
+# The index entry of every package is kept in a cache directory together
+# with the size, mtime and inode of the package it was made from, so only
+# new or rebuilt packages are hashed and unpacked again. Those are done by
+# up to IPKG_INDEX_JOBS parallel instances of this script.
+
+sha256() {
+	if command -v "${MKHASH:-mkhash}" >/dev/null; then
+		"${MKHASH:-mkhash}" sha256 "$1"
+	else
+		openssl dgst -sha256 "$1" 2>/dev/null | awk '{print $2}'
+	fi
+}
+
+# Usage: ipkg-make-index.sh --entry <cache_dir> <package> <key> [<package> <key>...]
+make_entries() {
+	local cache_dir=$1
+	local pkg key entry file_size sha256sum sed_safe_pkg
+	shift
+
+	while [[ $# -ge 2 ]]; do
+		pkg=$1
+		key=$2
+		shift 2
+
+		echo "Generating index for package $pkg" >&2
+		entry="$cache_dir/${pkg#./}.index"
+		file_size=${key%% *}
+		sha256sum=$(sha256 "$pkg")
+		# Take pains to make variable value sed-safe
+		sed_safe_pkg=$(echo "$pkg" | sed -e 's/^\.\///g' -e 's/\//\\\//g')
+
+		mkdir -p "${entry%/*}"
+		{
+			echo "#$key"
+			tar -xzOf "$pkg" ./control.tar.gz | tar xzOf - ./control | sed -e "s/^Description:/Filename: $sed_safe_pkg\\
+Size: $file_size\\
+SHA256sum: $sha256sum\\
+Description:/"
+			echo ""
+		} > "$entry.tmp"
+		mv "$entry.tmp" "$entry"
+	done
+}
+
+if [[ $1 = --entry ]]; then
+	shift
+	make_entries "$@"
+	exit 0
+fi
 
 pkg_dir=$1
 
@@ -8,20 +58,40 @@ if [[ -z $pkg_dir || ! -d $pkg_dir ]]; then
 	exit 1
 fi
 
-for pkg in $(find "$pkg_dir" -name '*.ipk' | sort); do
+jobs=${IPKG_INDEX_JOBS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}
+cache_dir=${IPKG_INDEX_CACHE:-${TMP_DIR:-${TMPDIR:-/tmp}}/ipkg-index/$(cd "$pkg_dir" && pwd -P | cksum | cut -d' ' -f1)}
+mkdir -p "$cache_dir"
+
+entries=()
+todo=()
+declare -A current
+
+while read -r size mtime inode pkg; do
 	name="${pkg##*/}"
 	name="${name%%_*}"
 	[[ "$name" = "kernel" ]] && continue
 	[[ "$name" = "libc" ]] && continue
-	echo "Generating index for package $pkg" >&2
-	file_size=$(stat -L -c%s "$pkg")
-	sha256sum=$(openssl dgst -sha256 "$pkg" 2>/dev/null | awk '{print $2}')
-	# Take pains to make variable value sed-safe
-	sed_safe_pkg=$(echo "$pkg" | sed -e 's/^\.\///g' -e 's/\//\\\//g')
-	tar -xzOf "$pkg" ./control.tar.gz | tar xzOf - ./control | sed -e "s/^Description:/Filename: $sed_safe_pkg\\
-Size: $file_size\\
-SHA256sum: $sha256sum\\
-Description:/"
-	echo ""
-done
+
+	key="$size $mtime $inode"
+	entry="$cache_dir/${pkg#./}.index"
+	entries+=("$entry")
+	current[$entry]=1
+
+	old=
+	[[ -f $entry ]] && read -r old < "$entry"
+	[[ "$old" = "#$key" ]] || todo+=("$pkg" "$key")
+done < <(find -L "$pkg_dir" -type f -name '*.ipk' -printf '%s %T@ %i %p\n' | sort -k4)
+
+if [[ ${#todo[@]} -gt 0 ]]; then
+	printf '%s\0' "${todo[@]}" | xargs -0 -n 16 -P "$jobs" "$0" --entry "$cache_dir"
+fi
+
+# Forget removed packages
+while IFS= read -r -d '' entry; do
+	[[ -n ${current[$entry]} ]] || rm -f "$entry"
+done < <(find "$cache_dir" -type f \( -name '*.index' -o -name '*.index.tmp' \) -print0)
+
+if [[ ${#entries[@]} -gt 0 ]]; then
+	printf '%s\0' "${entries[@]}" | xargs -0 awk 'FNR > 1'
+fi
 echo
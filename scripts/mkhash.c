@@ -85,11 +85,15 @@
 #include <sys/endian.h>
 #endif
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #define ARRAY_SIZE(_n) (sizeof(_n) / sizeof((_n)[0]))
@@ -451,6 +455,26 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 #define Maj(x, y, z)	((x & (y | z)) | (y & z))
 #define ROTR(x, n)	((x >> n) | (x << (32 - n)))
 
+/* SHA256 round constants. */
+static const uint32_t SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
 /*
  * SHA256 block compression function.  The 256-bit state is transformed via
  * the 512-bit input block to produce a new state.
@@ -458,25 +482,6 @@ be32dec_vect(uint32_t *dst, const unsigned char *src, size_t len)
 static void
 SHA256_Transform(uint32_t * state, const unsigned char block[64])
 {
-	/* SHA256 round constants. */
-	static const uint32_t K[64] = {
-		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-		0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-		0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-		0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-		0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-		0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-		0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-		0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-		0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-	};
 	uint32_t W[64];
 	uint32_t S[8];
 	int i;
@@ -498,7 +503,7 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 	    S[(66 - i) % 8], S[(67 - i) % 8],	\
 	    S[(68 - i) % 8], S[(69 - i) % 8],	\
 	    S[(70 - i) % 8], S[(71 - i) % 8],	\
-	    W[i + ii] + K[i + ii])
+	    W[i + ii] + SHA256_K[i + ii])
 
 /* Message schedule computation */
 #define MSCH(W, ii, i)				\
@@ -562,6 +567,187 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 		state[i] += S[i];
 }
 
+static void
+SHA256_Transform_generic(uint32_t *state, const unsigned char *data,
+			 size_t blocks)
+{
+	while (blocks--) {
+		SHA256_Transform(state, data);
+		data += 64;
+	}
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#define SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+
+/*
+ * SHA256 using the x86 SHA extensions.  The state is kept as ABEF/CDGH,
+ * the layout sha256rnds2 works on, while the blocks are processed.
+ */
+__attribute__((target("sha,sse4.1")))
+static void
+SHA256_Transform_x86(uint32_t *state, const unsigned char *data,
+		     size_t blocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, MSG, TMP, W[4];
+	int g;
+
+	TMP = _mm_loadu_si128((const __m128i *)&state[0]);
+	STATE1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xb1);		/* CDAB */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1b);	/* EFGH */
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);	/* ABEF */
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xf0);	/* CDGH */
+
+	while (blocks--) {
+		ABEF_SAVE = STATE0;
+		CDGH_SAVE = STATE1;
+
+		/* Four rounds per step, W[g & 3] holds message words 4g..4g+3 */
+		for (g = 0; g < 16; g++) {
+			if (g < 4)
+				W[g] = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(data + g * 16)), MASK);
+			else
+				W[g & 3] = _mm_sha256msg2_epu32(
+					_mm_add_epi32(
+						_mm_sha256msg1_epu32(W[g & 3], W[(g + 1) & 3]),
+						_mm_alignr_epi8(W[(g + 3) & 3], W[(g + 2) & 3], 4)),
+					W[(g + 3) & 3]);
+
+			MSG = _mm_add_epi32(W[g & 3],
+				_mm_loadu_si128((const __m128i *)&SHA256_K[g * 4]));
+			STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+			MSG = _mm_shuffle_epi32(MSG, 0x0e);
+			STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+		}
+
+		STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+		STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+		data += 64;
+	}
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1b);		/* FEBA */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xb1);	/* DCHG */
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xf0);	/* DCBA */
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);	/* HGFE */
+
+	_mm_storeu_si128((__m128i *)&state[0], STATE0);
+	_mm_storeu_si128((__m128i *)&state[4], STATE1);
+}
+
+static bool
+SHA256_have_x86(void)
+{
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d) ||
+	    !(c & bit_SSSE3) || !(c & bit_SSE4_1))
+		return false;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid_count(7, 0, a, b, c, d);
+
+	/* SHA */
+	return b & (1 << 29);
+}
+#endif
+
+#if defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO) || \
+     (!defined(__clang__) && __GNUC__ >= 8))
+#define SHA256_ARM
+#include <arm_neon.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+/* SHA256 using the ARMv8 cryptography extensions */
+#if !defined(__ARM_FEATURE_SHA2) && !defined(__ARM_FEATURE_CRYPTO)
+__attribute__((target("+crypto")))
+#endif
+static void
+SHA256_Transform_arm(uint32_t *state, const unsigned char *data,
+		     size_t blocks)
+{
+	uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, ABCD, TMP, W[4];
+	int g;
+
+	STATE0 = vld1q_u32(&state[0]);
+	STATE1 = vld1q_u32(&state[4]);
+
+	while (blocks--) {
+		ABEF_SAVE = STATE0;
+		CDGH_SAVE = STATE1;
+
+		for (g = 0; g < 4; g++)
+			W[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + g * 16)));
+
+		/* Four rounds per step, W[g & 3] holds message words 4g..4g+3 */
+		for (g = 0; g < 16; g++) {
+			TMP = vaddq_u32(W[g & 3], vld1q_u32(&SHA256_K[g * 4]));
+			if (g < 12)
+				W[g & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(W[g & 3], W[(g + 1) & 3]),
+					W[(g + 2) & 3], W[(g + 3) & 3]);
+
+			ABCD = STATE0;
+			STATE0 = vsha256hq_u32(STATE0, STATE1, TMP);
+			STATE1 = vsha256h2q_u32(STATE1, ABCD, TMP);
+		}
+
+		STATE0 = vaddq_u32(STATE0, ABEF_SAVE);
+		STATE1 = vaddq_u32(STATE1, CDGH_SAVE);
+		data += 64;
+	}
+
+	vst1q_u32(&state[0], STATE0);
+	vst1q_u32(&state[4], STATE1);
+}
+
+static bool
+SHA256_have_arm(void)
+{
+#if defined(__linux__)
+	return getauxval(AT_HWCAP) & HWCAP_SHA2;
+#elif defined(__APPLE__)
+	return true;
+#else
+	return false;
+#endif
+}
+#endif
+
+/* Processes whole blocks, set up by SHA256_select() */
+static void (*SHA256_Blocks)(uint32_t *state, const unsigned char *data,
+			     size_t blocks) = SHA256_Transform_generic;
+
+static void
+SHA256_select(void)
+{
+	if (getenv("MKHASH_NO_ACCEL"))
+		return;
+
+#ifdef SHA256_X86
+	if (SHA256_have_x86())
+		SHA256_Blocks = SHA256_Transform_x86;
+#endif
+#ifdef SHA256_ARM
+	if (SHA256_have_arm())
+		SHA256_Blocks = SHA256_Transform_arm;
+#endif
+}
+
 static unsigned char PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -585,7 +771,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	} else {
 		/* Finish the current block and mix. */
 		memcpy(&ctx->buf[r], PAD, 64 - r);
-		SHA256_Transform(ctx->state, ctx->buf);
+		SHA256_Blocks(ctx->state, ctx->buf, 1);
 
 		/* The start of the final block is all zeroes. */
 		memset(&ctx->buf[0], 0, 56);
@@ -595,7 +781,7 @@ SHA256_Pad(SHA256_CTX * ctx)
 	be64enc(&ctx->buf[56], ctx->count);
 
 	/* Mix in the final block. */
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 }
 
 /* SHA-256 initialization.  Begins a SHA-256 operation. */
@@ -642,15 +828,15 @@ SHA256_Update(SHA256_CTX * ctx, const void *in, size_t len)
 
 	/* Finish the current block */
 	memcpy(&ctx->buf[r], src, 64 - r);
-	SHA256_Transform(ctx->state, ctx->buf);
+	SHA256_Blocks(ctx->state, ctx->buf, 1);
 	src += 64 - r;
 	len -= 64 - r;
 
 	/* Perform complete blocks */
-	while (len >= 64) {
-		SHA256_Transform(ctx->state, src);
-		src += 64;
-		len -= 64;
+	if (len >= 64) {
+		SHA256_Blocks(ctx->state, src, len / 64);
+		src += len & ~(size_t)0x3f;
+		len &= 0x3f;
 	}
 
 	/* Copy left over data into buffer */
@@ -674,69 +860,69 @@ SHA256_Final(unsigned char digest[static SHA256_DIGEST_LENGTH], SHA256_CTX *ctx)
 	memset(ctx, 0, sizeof(*ctx));
 }
 
-static void *hash_buf(FILE *f, int *len)
-{
-	static char buf[1024];
 
-	*len = fread(buf, 1, sizeof(buf), f);
+union hash_ctx {
+	MD5_CTX md5;
+	SHA256_CTX sha256;
+};
 
-	return *len > 0 ? buf : NULL;
+static void md5_begin(union hash_ctx *ctx)
+{
+	MD5_begin(&ctx->md5);
 }
 
-static char *hash_string(unsigned char *buf, int len)
+static void md5_update(union hash_ctx *ctx, const void *data, size_t len)
 {
-	static char str[SHA256_DIGEST_LENGTH * 2 + 1];
-	int i;
-
-	if (len * 2 + 1 > sizeof(str))
-		return NULL;
-
-	for (i = 0; i < len; i++)
-		sprintf(&str[i * 2], "%02x", buf[i]);
-
-	return str;
+	MD5_hash(data, len, &ctx->md5);
 }
 
-static const char *md5_hash(FILE *f)
+static void md5_end(union hash_ctx *ctx, unsigned char *val)
 {
-	MD5_CTX ctx;
-	unsigned char val[MD5_DIGEST_LENGTH];
-	void *buf;
-	int len;
-
-	MD5_begin(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		MD5_hash(buf, len, &ctx);
-	MD5_end(val, &ctx);
-
-	return hash_string(val, MD5_DIGEST_LENGTH);
+	MD5_end(val, &ctx->md5);
 }
 
-static const char *sha256_hash(FILE *f)
+static void sha256_begin(union hash_ctx *ctx)
 {
-	SHA256_CTX ctx;
-	unsigned char val[SHA256_DIGEST_LENGTH];
-	void *buf;
-	int len;
+	SHA256_Init(&ctx->sha256);
+}
 
-	SHA256_Init(&ctx);
-	while ((buf = hash_buf(f, &len)) != NULL)
-		SHA256_Update(&ctx, buf, len);
-	SHA256_Final(val, &ctx);
+static void sha256_update(union hash_ctx *ctx, const void *data, size_t len)
+{
+	SHA256_Update(&ctx->sha256, data, len);
+}
 
-	return hash_string(val, SHA256_DIGEST_LENGTH);
+static void sha256_end(union hash_ctx *ctx, unsigned char *val)
+{
+	SHA256_Final(val, &ctx->sha256);
 }
 
 
 struct hash_type {
 	const char *name;
-	const char *(*func)(FILE *f);
+	void (*begin)(union hash_ctx *ctx);
+	void (*update)(union hash_ctx *ctx, const void *data, size_t len);
+	void (*end)(union hash_ctx *ctx, unsigned char *val);
 	int len;
 };
 
 struct hash_type types[] = {
-	{ "md5", md5_hash, MD5_DIGEST_LENGTH },
-	{ "sha256", sha256_hash, SHA256_DIGEST_LENGTH },
+	{ "md5", md5_begin, md5_update, md5_end, MD5_DIGEST_LENGTH },
+	{ "sha256", sha256_begin, sha256_update, sha256_end, SHA256_DIGEST_LENGTH },
+};
+
+/* One file to hash, results are printed in the order of the arguments */
+struct hash_job {
+	const char *filename;
+	const char *error;
+	char str[SHA256_DIGEST_LENGTH * 2 + 1];
+};
+
+struct hash_pool {
+	struct hash_type *t;
+	struct hash_job *jobs;
+	int n_jobs;
+	int next;
+	pthread_mutex_t lock;
 };
 
 
@@ -748,6 +934,8 @@ static int usage(const char *progname)
 		"Options:\n"
 		"	-n		Print filename(s)\n"
 		"	-N		Suppress trailing newline\n"
+		"	-b		Also read file names from stdin, one per line\n"
+		"	-j <n>		Hash up to <n> files in parallel (default: number of CPUs)\n"
 		"\n"
 		"Supported hash types:", progname);
 
@@ -771,42 +959,190 @@ static struct hash_type *get_hash_type(const char *name)
 	return NULL;
 }
 
+static void hash_string(char *str, const unsigned char *buf, int len)
+{
+	static const char hex[] = "0123456789abcdef";
+	int i;
+
+	for (i = 0; i < len; i++) {
+		str[i * 2] = hex[buf[i] >> 4];
+		str[i * 2 + 1] = hex[buf[i] & 0xf];
+	}
+	str[len * 2] = 0;
+}
 
-static int hash_file(struct hash_type *t, const char *filename, bool add_filename,
-	bool no_newline)
+static bool hash_read(struct hash_type *t, union hash_ctx *ctx, int fd)
 {
-	const char *str;
+	char buf[64 * 1024];
+	ssize_t len;
 
-	if (!filename || !strcmp(filename, "-")) {
-		str = t->func(stdin);
+	while ((len = read(fd, buf, sizeof(buf))) != 0) {
+		if (len < 0)
+			return false;
+		t->update(ctx, buf, len);
+	}
+
+	return true;
+}
+
+/* Regular files are hashed straight from the page cache through mmap */
+static bool hash_mmap(struct hash_type *t, union hash_ctx *ctx, int fd,
+		      size_t size)
+{
+	void *data;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+#ifdef MADV_SEQUENTIAL
+	madvise(data, size, MADV_SEQUENTIAL);
+#endif
+	t->update(ctx, data, size);
+	munmap(data, size);
+
+	return true;
+}
+
+static void hash_job(struct hash_type *t, struct hash_job *job)
+{
+	unsigned char val[SHA256_DIGEST_LENGTH];
+	union hash_ctx ctx;
+	struct stat st;
+	bool ok;
+	int fd;
+
+	if (!job->filename || !strcmp(job->filename, "-")) {
+		fd = STDIN_FILENO;
 	} else {
-		struct stat path_stat;
-		stat(filename, &path_stat);
-		if (S_ISDIR(path_stat.st_mode)) {
-			fprintf(stderr, "Failed to open '%s': Is a directory\n", filename);
-			return 1;
+		fd = open(job->filename, O_RDONLY);
+		if (fd < 0) {
+			job->error = "Failed to open '%s'\n";
+			return;
 		}
+	}
 
-		FILE *f = fopen(filename, "r");
+	t->begin(&ctx);
+	if (!fstat(fd, &st) && S_ISDIR(st.st_mode)) {
+		job->error = "Failed to open '%s': Is a directory\n";
+		ok = false;
+	} else if (fd != STDIN_FILENO && S_ISREG(st.st_mode) && st.st_size > 0 &&
+		   (uintmax_t)st.st_size <= SIZE_MAX &&
+		   hash_mmap(t, &ctx, fd, st.st_size)) {
+		ok = true;
+	} else {
+		ok = hash_read(t, &ctx, fd);
+		if (!ok)
+			job->error = "Failed to generate hash\n";
+	}
+	t->end(&ctx, val);
 
-		if (!f) {
-			fprintf(stderr, "Failed to open '%s'\n", filename);
-			return 1;
-		}
-		str = t->func(f);
-		fclose(f);
+	if (fd != STDIN_FILENO)
+		close(fd);
+
+	if (ok)
+		hash_string(job->str, val, t->len);
+}
+
+static void *hash_worker(void *arg)
+{
+	struct hash_pool *pool = arg;
+	int i;
+
+	while (1) {
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i >= pool->n_jobs)
+			break;
+
+		hash_job(pool->t, &pool->jobs[i]);
 	}
 
-	if (!str) {
-		fprintf(stderr, "Failed to generate hash\n");
+	return NULL;
+}
+
+static void hash_jobs(struct hash_type *t, struct hash_job *jobs, int n_jobs,
+		      int n_threads)
+{
+	struct hash_pool pool = {
+		.t = t,
+		.jobs = jobs,
+		.n_jobs = n_jobs,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
+	pthread_t *threads;
+	int i, started = 0;
+
+	if (n_threads > n_jobs)
+		n_threads = n_jobs;
+
+	threads = calloc(n_threads, sizeof(*threads));
+	for (i = 1; threads && i < n_threads; i++) {
+		if (pthread_create(&threads[i], NULL, hash_worker, &pool))
+			break;
+		started++;
+	}
+
+	/* The main thread is one of the workers */
+	hash_worker(&pool);
+
+	for (i = 1; i <= started; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+}
+
+static int print_job(struct hash_job *job, bool add_filename, bool no_newline)
+{
+	if (job->error) {
+		fprintf(stderr, job->error, job->filename);
 		return 1;
 	}
 
 	if (add_filename)
-		printf("%s %s%s", str, filename ? filename : "-",
+		printf("%s %s%s", job->str, job->filename ? job->filename : "-",
 			no_newline ? "" : "\n");
 	else
-		printf("%s%s", str, no_newline ? "" : "\n");
+		printf("%s%s", job->str, no_newline ? "" : "\n");
+	return 0;
+}
+
+static int add_job(struct hash_job **jobs, int *n_jobs, const char *filename)
+{
+	struct hash_job *new_jobs;
+
+	if (!(*n_jobs % 256)) {
+		new_jobs = realloc(*jobs, (*n_jobs + 256) * sizeof(**jobs));
+		if (!new_jobs)
+			return -1;
+		*jobs = new_jobs;
+	}
+
+	memset(&(*jobs)[*n_jobs], 0, sizeof(**jobs));
+	(*jobs)[(*n_jobs)++].filename = filename;
+
+	return 0;
+}
+
+static int read_jobs(struct hash_job **jobs, int *n_jobs)
+{
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &size, stdin)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = 0;
+		if (!len)
+			continue;
+
+		if (add_job(jobs, n_jobs, strdup(line)))
+			return -1;
+	}
+	free(line);
+
 	return 0;
 }
 
@@ -814,11 +1150,12 @@ static int hash_file(struct hash_type *t, const char *filename, bool add_filenam
 int main(int argc, char **argv)
 {
 	struct hash_type *t;
+	struct hash_job *jobs = NULL;
 	const char *progname = argv[0];
-	int i, ch;
-	bool add_filename = false, no_newline = false;
+	int i, ch, n_jobs = 0, n_threads = 0;
+	bool add_filename = false, no_newline = false, batch = false;
 
-	while ((ch = getopt(argc, argv, "nN")) != -1) {
+	while ((ch = getopt(argc, argv, "nNbj:")) != -1) {
 		switch (ch) {
 		case 'n':
 			add_filename = true;
@@ -826,6 +1163,12 @@ int main(int argc, char **argv)
 		case 'N':
 			no_newline = true;
 			break;
+		case 'b':
+			batch = true;
+			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			break;
 		default:
 			return usage(progname);
 		}
@@ -841,14 +1184,34 @@ int main(int argc, char **argv)
 	if (!t)
 		return usage(progname);
 
-	if (argc < 2)
-		return hash_file(t, NULL, add_filename, no_newline);
+	SHA256_select();
+
+	for (i = 1; i < argc; i++)
+		if (add_job(&jobs, &n_jobs, argv[i]))
+			goto oom;
+
+	if (batch && read_jobs(&jobs, &n_jobs))
+		goto oom;
+
+	if (!n_jobs && !batch && add_job(&jobs, &n_jobs, NULL))
+		goto oom;
 
-	for (i = 0; i < argc - 1; i++) {
-		int ret = hash_file(t, argv[1 + i], add_filename, no_newline);
+	if (n_threads < 1)
+		n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads < 1)
+		n_threads = 1;
+
+	hash_jobs(t, jobs, n_jobs, n_threads);
+
+	for (i = 0; i < n_jobs; i++) {
+		int ret = print_job(&jobs[i], add_filename, no_newline);
 		if (ret)
 			return ret;
 	}
 
 	return 0;
+
+oom:
+	fprintf(stderr, "Out of memory\n");
+	return 1;
 }
@@ -11,6 +11,8 @@ from subprocess import getoutput, getstatusoutput
 from sys import stderr
 from typing import Dict, Tuple, Union
 
+import squashfs_diff
+
 
 class bcolors:
     HEADER = "\033[95m"
@@ -256,6 +258,22 @@ def collect_files(root_dir: str) -> str:
     )
 
 
+def collect_image_files(image_path: str) -> str:
+    image = squashfs_diff.SquashfsImage(image_path)
+    try:
+        lines = sorted(
+            (p.rstrip("/") + "/" if is_dir else p, size)
+            for size, p, is_dir in squashfs_diff.du_lines(image)
+        )
+    finally:
+        image.close()
+
+    return (
+        f"{path.getsize(image_path)}\t{path.basename(image_path)}\n"
+        + "".join(f"{size}\t{name}\n" for name, size in lines)
+    )
+
+
 def collect_ipk_files(root_dir: str):
     return getoutput(f"find {root_dir} -name '*.ipk' -exec du --all --bytes {{}} \\; | perl -p -e 's/^(\\d+\\s+).*\\//\\1/'")
 
@@ -263,12 +281,17 @@ def collect_ipk_files(root_dir: str):
 def save(args: object, config: callable) -> None:
     root_dir = quote(args.info_path)
 
-    if path.isfile(root_dir):
+    if args.type == "fw" and squashfs_diff.is_squashfs(args.info_path):
+        try:
+            files_stats = collect_image_files(args.info_path)
+        except squashfs_diff.SquashfsError as e:
+            exit_w_err(str(e))
+    elif path.isfile(root_dir):
         exit_w_err(f"{args.root_info_pathdir}: not a directory")
     elif not path.isdir(root_dir):
         exit_w_err(f"{args.root_info_pathdir}: no such file or directory")
-
-    files_stats = collect_ipk_files(root_dir) if args.type == "ipk" else collect_files(root_dir)
+    else:
+        files_stats = collect_ipk_files(root_dir) if args.type == "ipk" else collect_files(root_dir)
 
     output_file = config.logs_dir + config.fw_version + config.extension
     with open(output_file, "w") as file:
@@ -331,7 +354,7 @@ def parse_args() -> object:
     parser_save = subparsers.add_parser("save", aliases=["s"], help="Save information about the FW file system")
     parser_save.add_argument(
         "info_path",
-        help="A root directory of device files (ROM), like build_dir/target-*/root-*",
+        help="A root directory of device files (ROM), like build_dir/target-*/root-*, or a root.squashfs image",
     )
     parser_save.set_defaults(func=save)
 
@@ -0,0 +1,199 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-only
+#
+###
+### rootfs-benchmark - compare root filesystem compression settings
+###
+### "make target/linux/benchmark" builds the root filesystem with every
+### squashfs compressor and block size and every jffs2 erase block size
+### into bin/targets/<target>/<subtarget>/rootfs-benchmark/, together with
+### sizes.txt and this script.
+###
+### Usage:
+###   rootfs-benchmark.sh sizes <dir>
+###     Print the size of every image in <dir> (done by the build).
+###
+###   rootfs-benchmark.sh run [-l <boot order list>] <image>...
+###     On a device (or a qemu-arm system with the images on a disk),
+###     mount every image read-only and measure, with cold caches:
+###       - read:  time and throughput reading every file once
+###       - cache: page cache and buffer memory held after that read
+###       - boot:  time to read the files of the boot order list, as
+###                written by squashfs-boot-trace.sh, in boot order
+###     Copy the images to a tmpfs first to measure the decompression
+###     cost alone, or to a flash partition to include the flash.
+###     jffs2 images need the block2mtd module.
+###
+
+usage() {
+	grep '^###' "$0" | sed 's/^### \{0,1\}//' >&2
+	exit 1
+}
+
+image_type() {
+	case "${1##*/}" in
+	root.squashfs*) echo squashfs ;;
+	root.jffs2*) echo jffs2 ;;
+	esac
+}
+
+sizes() {
+	local dir="$1" img size base
+
+	printf "%-32s %10s %7s\n" image bytes "% min"
+	base=$(ls -l "$dir"/root.* | awk 'NR == 1 || $5 < min { min = $5 } END { print min }')
+	for img in "$dir"/root.*; do
+		[ -f "$img" ] || continue
+		size=$(wc -c < "$img")
+		printf "%-32s %10d %7s\n" "${img##*/}" "$size" \
+			"$(awk -v s="$size" -v b="$base" 'BEGIN { printf "%.1f", s * 100 / b }')"
+	done
+}
+
+# Monotonic time in ms, from /proc/uptime
+now_ms() {
+	awk '{ printf "%d\n", $1 * 1000 }' /proc/uptime
+}
+
+cached_kb() {
+	awk '/^(Cached|Buffers):/ { kb += $2 } END { print kb }' /proc/meminfo
+}
+
+drop_caches() {
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+}
+
+# Sectors read from the device backing <mnt>, so the compressed bytes read
+sectors_read() {
+	local dev
+
+	dev=$(awk -v mnt="$1" '$5 == mnt { print $3 }' /proc/self/mountinfo)
+	[ -n "$dev" ] && [ -f "/sys/dev/block/$dev/stat" ] || { echo 0; return; }
+	awk '{ print $3 }' "/sys/dev/block/$dev/stat"
+}
+
+# jffs2 images go through a loop device and block2mtd
+mtd_loop=
+
+mount_image() {
+	local img="$1" mnt="$2" erase
+
+	case "$(image_type "$img")" in
+	squashfs)
+		mount -t squashfs -o ro,loop "$img" "$mnt"
+		;;
+	jffs2)
+		erase=${img##*jffs2-}
+		erase=${erase%%[!0-9]*}
+		[ -n "$erase" ] || return 1
+		mtd_loop=$(losetup -f) && losetup "$mtd_loop" "$img" || return 1
+		insmod block2mtd "block2mtd=$mtd_loop,${erase}KiB" || {
+			losetup -d "$mtd_loop"
+			return 1
+		}
+		# mtd3: 00100000 00010000 "block2mtd: /dev/loop0"
+		mount -t jffs2 -o ro "$(awk -v l="$mtd_loop" '$0 ~ "block2mtd: " l {
+			sub(":", "", $1); print "/dev/mtdblock" substr($1, 4) }' /proc/mtd)" "$mnt"
+		;;
+	*)
+		return 1
+		;;
+	esac
+}
+
+umount_image() {
+	local mnt="$1"
+
+	# the squashfs loop device is released by umount itself
+	umount "$mnt"
+	if [ -n "$mtd_loop" ]; then
+		rmmod block2mtd
+		losetup -d "$mtd_loop"
+		mtd_loop=
+	fi
+}
+
+# Read the files named on stdin, print the number of bytes read
+read_files() {
+	while IFS= read -r file; do
+		[ -f "$file" ] && echo "$file"
+	done | xargs cat | wc -c
+}
+
+run_one() {
+	local img="$1" list="$2" mnt start end kb bytes sectors files boot
+
+	mnt=$(mktemp -d)
+	if ! mount_image "$img" "$mnt"; then
+		echo "${img##*/}: cannot mount" >&2
+		rmdir "$mnt"
+		return 1
+	fi
+
+	files=$(find "$mnt" -xdev -type f | wc -l)
+
+	drop_caches
+	kb=$(cached_kb)
+	sectors=$(sectors_read "$mnt")
+	start=$(now_ms)
+	bytes=$(find "$mnt" -xdev -type f -exec cat {} + | wc -c)
+	end=$(now_ms)
+	kb=$(($(cached_kb) - kb))
+	sectors=$(($(sectors_read "$mnt") - sectors))
+
+	boot=-
+	if [ -n "$list" ]; then
+		drop_caches
+		boot=$(now_ms)
+		sed "s,^/*,$mnt/," "$list" | read_files > /dev/null
+		boot=$(($(now_ms) - boot))
+	fi
+
+	umount_image "$mnt"
+	rmdir "$mnt"
+
+	awk -v name="${img##*/}" -v files="$files" -v bytes="$bytes" \
+		-v ms="$((end - start))" -v kb="$kb" -v sectors="$sectors" \
+		-v boot="$boot" 'BEGIN {
+		if (ms < 1) ms = 1
+		printf "%-32s %6d %8d %8.2f %8d %8d %8s\n", name, files, ms,
+			bytes / 1048.576 / ms, sectors / 2, kb, boot
+	}'
+}
+
+run() {
+	local list= img
+
+	if [ "$1" = "-l" ]; then
+		list="$2"
+		shift 2
+		[ -f "$list" ] || usage
+	fi
+	[ $# -gt 0 ] || usage
+
+	if [ ! -w /proc/sys/vm/drop_caches ]; then
+		echo "Cannot drop caches, run as root" >&2
+		exit 1
+	fi
+
+	printf "%-32s %6s %8s %8s %8s %8s %8s\n" \
+		image files "read ms" "MB/s" "read kB" "cache kB" "boot ms"
+	for img in "$@"; do
+		run_one "$img" "$list"
+	done
+}
+
+case "$1" in
+sizes)
+	[ -d "$2" ] || usage
+	sizes "$2"
+	;;
+run)
+	shift
+	run "$@"
+	;;
+*)
+	usage
+	;;
+esac
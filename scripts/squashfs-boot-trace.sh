@@ -0,0 +1,86 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Run on a device to print the files of the squashfs root filesystem in the
+# order they were first read during this boot, up to "init complete". The
+# output is meant for CONFIG_TARGET_SQUASHFS_BOOT_ORDER.
+#
+# Needs a kernel with CONFIG_KERNEL_FTRACE and
+# CONFIG_KERNEL_ENABLE_DEFAULT_TRACERS, booted with
+#
+#   trace_event=filemap:mm_filemap_add_to_page_cache trace_buf_size=8M
+#
+# added to the kernel command line, so every page read into the page cache
+# is recorded from the very start. Disable the event again afterwards with
+# "echo 0 > <tracefs>/events/filemap/enable".
+
+tracefs=
+for dir in /sys/kernel/tracing /sys/kernel/debug/tracing; do
+	[ -f "$dir/trace" ] && { tracefs="$dir"; break; }
+done
+if [ -z "$tracefs" ]; then
+	mount -t tracefs nodev /sys/kernel/tracing 2>/dev/null && \
+		tracefs=/sys/kernel/tracing
+fi
+if [ -z "$tracefs" ]; then
+	echo "tracefs not available, is ftrace enabled in the kernel?" >&2
+	exit 1
+fi
+
+# mountinfo: id parent major:minor root mountpoint options ... - fstype ...
+set -- $(awk '$0 ~ / - squashfs / { print $5, $3; if ($5 == "/rom") exit }' \
+	/proc/self/mountinfo | tail -n 1)
+mnt="$1"
+dev="$2"
+if [ -z "$dev" ]; then
+	echo "No squashfs filesystem mounted" >&2
+	exit 1
+fi
+
+# Kernel timestamp of "- init complete -", later reads are not boot reads
+done_ts=$(dmesg | sed -n 's/^\[ *\([0-9.]*\)\].*- init complete -.*/\1/p' | head -n 1)
+
+trace=$(mktemp)
+inodes=$(mktemp)
+trap 'rm -f "$trace" "$inodes"' EXIT
+
+# <task>-<pid> [cpu] flags ts: mm_filemap_add_to_page_cache: dev M:m ino <hex> ...
+awk -v dev="$dev" -v done_ts="${done_ts:-0}" '
+	/mm_filemap_add_to_page_cache:/ {
+		for (i = 1; i < NF; i++) {
+			if ($i ~ /^[0-9.]+:$/)
+				ts = substr($i, 1, length($i) - 1)
+			if ($i == "dev" && $(i + 1) == dev && $(i + 2) == "ino") {
+				if (done_ts > 0 && ts + 0 > done_ts + 0)
+					exit
+				ino = $(i + 3)
+				if (!seen[ino]++)
+					print ino
+				break
+			}
+		}
+	}' "$tracefs/trace" > "$trace"
+
+if [ ! -s "$trace" ]; then
+	echo "No page cache events for $mnt ($dev) in $tracefs/trace" >&2
+	exit 1
+fi
+
+find "$mnt" -xdev -type f -exec ls -i {} + > "$inodes"
+
+awk -v mnt="$mnt" '
+	FNR == NR {
+		ino = $1
+		sub(/^ *[0-9]+ /, "")
+		path[ino] = substr($0, length(mnt) + 1)
+		next
+	}
+	{
+		ino = 0
+		hex = tolower($1)
+		sub(/^0x/, "", hex)
+		for (i = 1; i <= length(hex); i++)
+			ino = ino * 16 + index("0123456789abcdef", substr(hex, i, 1)) - 1
+		if (ino in path)
+			print path[ino]
+	}' "$inodes" "$trace"
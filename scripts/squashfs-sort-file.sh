@@ -0,0 +1,30 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Turn a list of root filesystem files in boot access order, as written by
+# squashfs-boot-trace.sh, into a mksquashfs sort file for the tree in
+# <root>. The first file gets the highest priority and all unlisted files
+# keep priority 0, so mksquashfs writes the boot files first and in the
+# order they are read. Entries that are not regular files in <root> are
+# skipped, mksquashfs refuses sort files with unknown paths.
+
+if [ $# -ne 2 ] || [ ! -f "$1" ] || [ ! -d "$2" ]; then
+	echo "Usage: $0 <boot order list> <root dir>" >&2
+	exit 1
+fi
+
+list="$1"
+root="$2"
+prio=32767
+
+awk '!seen[$0]++' "$list" | while IFS= read -r file; do
+	file="${file#/}"
+	case "$file" in
+	""|*[[:space:]]*|../*|*/../*) continue ;;
+	esac
+
+	[ -f "$root/$file" ] && [ ! -L "$root/$file" ] || continue
+
+	echo "$file $prio"
+	[ "$prio" -gt 1 ] && prio=$((prio - 1))
+done
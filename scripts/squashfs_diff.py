@@ -0,0 +1,703 @@
+#!/usr/bin/env python3
+"""Compare two squashfs firmware images without unpacking them.
+
+The directory and inode tables of both images are streamed straight from the
+image files, file contents are hashed in parallel and the differences are
+written as JSON. Optionally a block-level delta of the new image against the
+old one is produced: every data or fragment block of the new image that is
+stored byte for byte in the old image becomes a copy operation, everything
+else is literal data.
+
+Only the Python standard library is needed for gzip, lzma and xz images. lz4
+and zstd images need the 'lz4' and 'zstandard' modules.
+"""
+from __future__ import annotations
+
+import argparse
+import hashlib
+import json
+import lzma
+import mmap
+import stat
+import struct
+import zlib
+from concurrent.futures import ThreadPoolExecutor
+from os import cpu_count
+from pathlib import Path
+from sys import exit as sys_exit
+from sys import stderr, stdout
+from threading import Lock
+
+SQUASHFS_MAGIC = 0x73717368
+SUPERBLOCK = struct.Struct("<IIIIIHHHHHHQQQQQQQQ")
+METADATA_SIZE = 8192
+NO_FRAGMENT = 0xFFFFFFFF
+BLOCK_UNCOMPRESSED = 1 << 24
+METADATA_UNCOMPRESSED = 0x8000
+
+COMPRESSORS = {1: "gzip", 2: "lzma", 3: "lzo", 4: "xz", 5: "lz4", 6: "zstd"}
+
+# Inode types, the extended type of each is the basic type + 7
+DIR, FILE, SYMLINK, BLKDEV, CHRDEV, FIFO, SOCKET = range(1, 8)
+TYPE_NAMES = {DIR: "dir", FILE: "file", SYMLINK: "symlink", BLKDEV: "blkdev", CHRDEV: "chrdev", FIFO: "fifo", SOCKET: "socket"}
+TYPE_MODES = {
+    DIR: stat.S_IFDIR,
+    FILE: stat.S_IFREG,
+    SYMLINK: stat.S_IFLNK,
+    BLKDEV: stat.S_IFBLK,
+    CHRDEV: stat.S_IFCHR,
+    FIFO: stat.S_IFIFO,
+    SOCKET: stat.S_IFSOCK,
+}
+
+
+class SquashfsError(Exception):
+    """Raised for images that are not squashfs 4.0 or cannot be read."""
+
+
+def get_decompressor(compressor: int) -> callable:
+    """Return a function decompressing one block of the given compressor.
+
+    Args:
+        compressor (int): The compressor id from the superblock.
+
+    Returns:
+        callable: A function taking the compressed data and the maximum uncompressed size.
+
+    Raises:
+        SquashfsError: If the compressor is not supported.
+
+    """
+    name = COMPRESSORS.get(compressor, str(compressor))
+
+    if name == "gzip":
+        return lambda data, _: zlib.decompress(data)
+    if name == "xz":
+        return lambda data, _: lzma.decompress(data, format=lzma.FORMAT_XZ)
+    if name == "lzma":
+        return lambda data, _: lzma.decompress(data, format=lzma.FORMAT_ALONE)
+    if name == "lz4":
+        try:
+            import lz4.block
+        except ImportError as e:
+            raise SquashfsError("lz4 images need the 'lz4' Python module") from e
+        return lambda data, size: lz4.block.decompress(data, uncompressed_size=size)
+    if name == "zstd":
+        try:
+            import zstandard
+        except ImportError as e:
+            raise SquashfsError("zstd images need the 'zstandard' Python module") from e
+        return lambda data, size: zstandard.ZstdDecompressor().decompress(data, max_output_size=size)
+
+    raise SquashfsError(f"Unsupported compressor '{name}'")
+
+
+class Entry:
+    """A file system entry of an image.
+
+    Attributes:
+        path (str): Absolute path of the entry.
+        type (int): Basic inode type.
+        mode (int): Permission bits.
+        uid (int): Owner.
+        gid (int): Group.
+        size (int): File size, symlink target length or 0.
+        inode (int): Inode number, shared by hard links.
+        target (str): Symlink target.
+        rdev (int): Device number of device nodes.
+        blocks (list[tuple[int, int]]): Offset and on-disk size of every data block.
+        fragment (tuple[int, int, int] | None): Fragment index, offset and length of the file tail.
+        listing (tuple[int, int, int] | None): Metadata block, offset and size of a directory listing.
+
+    """
+
+    __slots__ = ("blocks", "fragment", "gid", "inode", "listing", "mode", "path", "rdev", "size", "target", "type", "uid")
+
+    def __init__(self, path: str, inode_type: int, mode: int, uid: int, gid: int, inode: int) -> None:
+        """Initialize an entry without contents."""
+        self.path = path
+        self.type = inode_type
+        self.mode = mode
+        self.uid = uid
+        self.gid = gid
+        self.inode = inode
+        self.size = 0
+        self.target = None
+        self.rdev = None
+        self.blocks = []
+        self.fragment = None
+        self.listing = None
+
+
+class SquashfsImage:
+    """Read-only access to a squashfs 4.0 image through mmap.
+
+    Attributes:
+        path (Path): The image file.
+        size (int): Size of the image file.
+        block_size (int): Data block size.
+        compressor (str): Compressor name.
+        bytes_used (int): Bytes used by the file system.
+
+    """
+
+    def __init__(self, path: str, offset: int = 0) -> None:
+        """Open an image and read its superblock, id and fragment tables.
+
+        Args:
+            path (str): The image file.
+            offset (int, optional): Offset of the file system in the file. Defaults to 0.
+
+        Raises:
+            SquashfsError: If the file is not a squashfs 4.0 image.
+
+        """
+        self.path = Path(path)
+        with self.path.open("rb") as f:
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.size = len(self.data) - offset
+        self.offset = offset
+
+        if self.size < SUPERBLOCK.size:
+            raise SquashfsError(f"{path}: too small for a squashfs image")
+
+        (
+            magic,
+            _inode_count,
+            _mod_time,
+            self.block_size,
+            frag_count,
+            compressor,
+            _block_log,
+            _flags,
+            id_count,
+            major,
+            minor,
+            self.root_inode,
+            self.bytes_used,
+            id_table,
+            _xattr_table,
+            self.inode_table,
+            self.directory_table,
+            fragment_table,
+            _export_table,
+        ) = SUPERBLOCK.unpack_from(self.data, offset)
+
+        if magic != SQUASHFS_MAGIC:
+            raise SquashfsError(f"{path}: not a squashfs image")
+        if (major, minor) != (4, 0):
+            raise SquashfsError(f"{path}: squashfs {major}.{minor} is not supported")
+
+        self.compressor = COMPRESSORS.get(compressor, str(compressor))
+        self.decompress = get_decompressor(compressor)
+        self.metadata_cache = {}
+        self.fragment_cache = {}
+        self.lock = Lock()
+
+        self.ids = [i for (i,) in struct.iter_unpack("<I", self.read_table(id_table, id_count * 4))]
+        self.fragments = list(struct.iter_unpack("<QII", self.read_table(fragment_table, frag_count * 16)))
+
+    def close(self) -> None:
+        """Unmap the image."""
+        self.data.close()
+
+    def raw(self, start: int, length: int) -> bytes:
+        """Return bytes of the file system as stored in the image."""
+        return self.data[self.offset + start : self.offset + start + length]
+
+    def read_block(self, start: int, size: int) -> bytes:
+        """Read and decompress one data or fragment block.
+
+        Args:
+            start (int): Offset of the block.
+            size (int): On-disk size with the uncompressed flag.
+
+        Returns:
+            bytes: The uncompressed block.
+
+        """
+        data = self.raw(start, size & ~BLOCK_UNCOMPRESSED)
+        if size & BLOCK_UNCOMPRESSED:
+            return data
+        return self.decompress(data, self.block_size)
+
+    def metadata_block(self, start: int) -> tuple[bytes, int]:
+        """Read the metadata block at the given offset.
+
+        Args:
+            start (int): Offset of the block header.
+
+        Returns:
+            tuple[bytes, int]: The uncompressed block and the offset of the next block.
+
+        """
+        block = self.metadata_cache.get(start)
+        if block:
+            return block
+
+        (header,) = struct.unpack_from("<H", self.data, self.offset + start)
+        length = header & ~METADATA_UNCOMPRESSED
+        data = self.raw(start + 2, length)
+        if not header & METADATA_UNCOMPRESSED:
+            data = self.decompress(data, METADATA_SIZE)
+
+        block = (data, start + 2 + length)
+        self.metadata_cache[start] = block
+        return block
+
+    def read_metadata(self, start: int, offset: int, length: int) -> tuple[bytes, int, int]:
+        """Read from the metadata stream starting at a block and an offset in it.
+
+        Args:
+            start (int): Offset of the metadata block.
+            offset (int): Offset in the uncompressed block.
+            length (int): Number of bytes to read.
+
+        Returns:
+            tuple[bytes, int, int]: The data and the block and offset after it.
+
+        """
+        out = bytearray()
+        while True:
+            data, next_start = self.metadata_block(start)
+            chunk = data[offset : offset + length - len(out)]
+            out += chunk
+            offset += len(chunk)
+            if len(out) == length:
+                return bytes(out), start, offset
+            if not chunk and offset < len(data):
+                raise SquashfsError(f"{self.path}: corrupt metadata at {start}")
+            start, offset = next_start, 0
+
+    def read_table(self, start: int, length: int) -> bytes:
+        """Read a table stored as a list of metadata block pointers (ids, fragments)."""
+        if not length:
+            return b""
+
+        blocks = (length + METADATA_SIZE - 1) // METADATA_SIZE
+        pointers = struct.unpack_from(f"<{blocks}Q", self.data, self.offset + start)
+        return b"".join(self.metadata_block(p)[0] for p in pointers)[:length]
+
+    def read_inode(self, ref: int, path: str) -> Entry:
+        """Read an inode.
+
+        Args:
+            ref (int): Inode reference, metadata block << 16 | offset.
+            path (str): Path of the entry.
+
+        Returns:
+            Entry: The entry.
+
+        """
+        start, offset = self.inode_table + (ref >> 16), ref & 0xFFFF
+
+        def read(fmt: str) -> tuple:
+            nonlocal start, offset
+            data, start, offset = self.read_metadata(start, offset, struct.calcsize(fmt))
+            return struct.unpack(fmt, data)
+
+        inode_type, mode, uid, gid, _mtime, inode = read("<HHHHII")
+        basic = inode_type if inode_type <= SOCKET else inode_type - 7
+        entry = Entry(path, basic, mode, self.ids[uid], self.ids[gid], inode)
+
+        if inode_type == DIR:
+            block, _links, size, block_offset, _parent = read("<IIHHI")
+            entry.listing = (self.directory_table + block, block_offset, size)
+        elif inode_type == DIR + 7:
+            _links, size, block, _parent, _index_count, block_offset, _xattr = read("<IIIIHHI")
+            entry.listing = (self.directory_table + block, block_offset, size)
+        elif inode_type in (FILE, FILE + 7):
+            if inode_type == FILE:
+                blocks_start, frag, frag_offset, entry.size = read("<IIII")
+            else:
+                blocks_start, entry.size, _sparse, _links, frag, frag_offset, _xattr = read("<QQQIIII")
+
+            count = entry.size // self.block_size
+            if frag == NO_FRAGMENT and entry.size % self.block_size:
+                count += 1
+            elif frag != NO_FRAGMENT:
+                entry.fragment = (frag, frag_offset, entry.size % self.block_size)
+
+            pos = blocks_start
+            for size in read(f"<{count}I"):
+                entry.blocks.append((pos, size))
+                pos += size & ~BLOCK_UNCOMPRESSED
+        elif inode_type in (SYMLINK, SYMLINK + 7):
+            _links, entry.size = read("<II")
+            (target,) = read(f"<{entry.size}s")
+            entry.target = target.decode(errors="surrogateescape")
+        elif inode_type in (BLKDEV, CHRDEV, BLKDEV + 7, CHRDEV + 7):
+            _links, entry.rdev = read("<II")
+
+        return entry
+
+    def walk(self) -> iter:
+        """Yield every entry of the image, directories before their contents.
+
+        Yields:
+            Entry: The entries.
+
+        """
+        root = self.read_inode(self.root_inode, "/")
+        stack = [root]
+
+        while stack:
+            directory = stack.pop()
+            yield directory
+
+            start, offset, size = directory.listing
+            # The listing size includes 3 bytes for "." and ".."
+            remaining = size - 3
+            children = []
+
+            while remaining > 0:
+                data, start, offset = self.read_metadata(start, offset, 12)
+                count, inode_block, _inode_base = struct.unpack("<III", data)
+                remaining -= 12
+
+                for _ in range(count + 1):
+                    data, start, offset = self.read_metadata(start, offset, 8)
+                    inode_offset, _delta, _type, name_size = struct.unpack("<HhHH", data)
+                    name, start, offset = self.read_metadata(start, offset, name_size + 1)
+                    remaining -= 8 + name_size + 1
+
+                    name = name.decode(errors="surrogateescape")
+                    path = directory.path.rstrip("/") + "/" + name
+                    children.append(self.read_inode(inode_block << 16 | inode_offset, path))
+
+            for child in reversed(children):
+                if child.type == DIR:
+                    stack.append(child)
+                else:
+                    yield child
+
+    def fragment_block(self, index: int) -> bytes:
+        """Return an uncompressed fragment block, decompressed once per image."""
+        with self.lock:
+            block = self.fragment_cache.get(index)
+        if block is None:
+            start, size, _ = self.fragments[index]
+            block = self.read_block(start, size)
+            with self.lock:
+                self.fragment_cache[index] = block
+        return block
+
+    def file_hash(self, entry: Entry) -> str:
+        """Return the SHA-256 of the contents of a regular file."""
+        h = hashlib.sha256()
+        remaining = entry.size
+
+        for start, size in entry.blocks:
+            if size & ~BLOCK_UNCOMPRESSED:
+                block = self.read_block(start, size)
+            else:
+                # Sparse block
+                block = bytes(min(self.block_size, remaining))
+            h.update(block)
+            remaining -= len(block)
+
+        if entry.fragment:
+            index, offset, length = entry.fragment
+            h.update(self.fragment_block(index)[offset : offset + length])
+
+        return h.hexdigest()
+
+    def extents(self) -> iter:
+        """Yield offset and on-disk length of every data and fragment block.
+
+        Yields:
+            tuple[int, int]: Offset and length.
+
+        """
+        seen = set()
+        for entry in self.walk():
+            for start, size in entry.blocks:
+                length = size & ~BLOCK_UNCOMPRESSED
+                if length and start not in seen:
+                    seen.add(start)
+                    yield start, length
+
+        for start, size, _ in self.fragments:
+            length = size & ~BLOCK_UNCOMPRESSED
+            if length and start not in seen:
+                seen.add(start)
+                yield start, length
+
+
+def scan(image: SquashfsImage, jobs: int) -> dict[str, dict]:
+    """Collect every entry of an image with the hash of its contents.
+
+    Args:
+        image (SquashfsImage): The image.
+        jobs (int): Number of files hashed in parallel.
+
+    Returns:
+        dict[str, dict]: Entry information by path.
+
+    """
+    entries = list(image.walk())
+    # Hard links are hashed once
+    files = {e.inode: e for e in entries if e.type == FILE}
+
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        hashes = dict(zip(files, pool.map(image.file_hash, files.values())))
+
+    result = {}
+    for e in entries:
+        info = {
+            "type": TYPE_NAMES[e.type],
+            "mode": oct(TYPE_MODES[e.type] | e.mode),
+            "uid": e.uid,
+            "gid": e.gid,
+            "size": e.size,
+        }
+        if e.type == FILE:
+            info["sha256"] = hashes[e.inode]
+        elif e.type == SYMLINK:
+            info["target"] = e.target
+        elif e.rdev is not None:
+            info["rdev"] = e.rdev
+        result[e.path] = info
+
+    return result
+
+
+def du_lines(image: SquashfsImage) -> iter:
+    """Yield 'size<TAB>path' lines like 'du --all --bytes', directories with the size of their contents.
+
+    Yields:
+        tuple[int, str, bool]: Size, path and whether it is a directory.
+
+    """
+    dir_sizes = {}
+    entries = []
+
+    for e in image.walk():
+        entries.append((e.path, e.type == DIR, e.size))
+        if e.type == DIR:
+            dir_sizes[e.path] = 0
+            continue
+        parent = e.path
+        while parent != "/":
+            parent = parent.rsplit("/", 1)[0] or "/"
+            dir_sizes[parent] += e.size
+
+    for path, is_dir, size in entries:
+        yield (dir_sizes[path] if is_dir else size), path, is_dir
+
+
+def compare(old: dict[str, dict], new: dict[str, dict]) -> dict:
+    """Compare the entries of two images.
+
+    Args:
+        old (dict[str, dict]): Entries of the old image.
+        new (dict[str, dict]): Entries of the new image.
+
+    Returns:
+        dict: Added, removed and changed entries and the number of unchanged ones.
+
+    """
+    added = [{"path": p, **new[p]} for p in sorted(new.keys() - old.keys())]
+    removed = [{"path": p, **old[p]} for p in sorted(old.keys() - new.keys())]
+    changed = []
+    unchanged = 0
+
+    for path in sorted(old.keys() & new.keys()):
+        o, n = old[path], new[path]
+        fields = [k for k in ("type", "sha256", "target", "rdev", "mode", "uid", "gid") if o.get(k) != n.get(k)]
+        if not fields:
+            unchanged += 1
+            continue
+
+        changed.append(
+            {
+                "path": path,
+                "type": n["type"],
+                "changes": fields,
+                "old_size": o["size"],
+                "new_size": n["size"],
+                "size_diff": n["size"] - o["size"],
+            },
+        )
+
+    return {"added": added, "removed": removed, "changed": changed, "unchanged": unchanged}
+
+
+def delta_ops(old: SquashfsImage, new: SquashfsImage) -> iter:
+    """Describe the new image as copies of blocks of the old image and literal data.
+
+    Data and fragment blocks are matched by the hash of their stored bytes, so
+    the delta is only useful between images with the same compressor and block
+    size. Adjacent operations are merged.
+
+    Args:
+        old (SquashfsImage): The image the delta applies to.
+        new (SquashfsImage): The image the delta produces.
+
+    Yields:
+        list: ["copy", offset in the old image, length] or ["data", offset in the new image, length].
+
+    """
+    old_blocks = {}
+    for start, length in old.extents():
+        old_blocks.setdefault(hashlib.sha256(old.raw(start, length)).digest(), start)
+
+    last = None
+    pos = 0
+    for start, length in [*sorted(new.extents()), (new.size, 0)]:
+        if start < pos:
+            continue
+        src = old_blocks.get(hashlib.sha256(new.raw(start, length)).digest()) if length else None
+        if src is None and length:
+            continue
+
+        for op in (["data", pos, start - pos], ["copy", src, length]):
+            if not op[2]:
+                continue
+            if last and last[0] == op[0] and last[1] + last[2] == op[1]:
+                last[2] += op[2]
+                continue
+            if last:
+                yield last
+            last = op
+        pos = start + length
+
+    if last:
+        yield last
+
+
+def block_delta(old: SquashfsImage, new: SquashfsImage, data_path: Path) -> dict:
+    """Describe the new image as copies of blocks of the old image and literal data.
+
+    The literal data is written to data_path in the order of the 'data'
+    operations.
+
+    Args:
+        old (SquashfsImage): The image the delta applies to.
+        new (SquashfsImage): The image the delta produces.
+        data_path (Path): File for the literal data.
+
+    Returns:
+        dict: The delta manifest.
+
+    """
+    ops = []
+    with data_path.open("wb") as data:
+        for op, start, length in delta_ops(old, new):
+            if op == "data":
+                data.write(new.raw(start, length))
+                ops.append(["data", length])
+            else:
+                ops.append(["copy", start, length])
+
+    copied = sum(op[2] for op in ops if op[0] == "copy")
+
+    return {
+        "format": "squashfs-block-delta",
+        "version": 1,
+        "old": {"size": old.size, "sha256": hashlib.sha256(old.raw(0, old.size)).hexdigest()},
+        "new": {"size": new.size, "sha256": hashlib.sha256(new.raw(0, new.size)).hexdigest()},
+        "copied": copied,
+        "literal": new.size - copied,
+        "ops": ops,
+    }
+
+
+def image_info(image: SquashfsImage, entries: dict[str, dict]) -> dict:
+    """Return a summary of an image."""
+    return {
+        "image": str(image.path),
+        "size": image.size,
+        "bytes_used": image.bytes_used,
+        "compressor": image.compressor,
+        "block_size": image.block_size,
+        "entries": len(entries),
+        "files_size": sum(e["size"] for e in entries.values() if e["type"] == "file"),
+    }
+
+
+def diff_images(old_path: str, new_path: str, jobs: int | None = None, delta: str | None = None) -> dict:
+    """Compare two squashfs images.
+
+    Args:
+        old_path (str): The old image.
+        new_path (str): The new image.
+        jobs (int, optional): Number of files hashed in parallel. Defaults to the number of CPUs.
+        delta (str, optional): Write a block-level delta to <delta>.json and <delta>.bin.
+
+    Returns:
+        dict: The differences.
+
+    """
+    jobs = jobs or cpu_count() or 1
+    old = SquashfsImage(old_path)
+    new = SquashfsImage(new_path)
+
+    try:
+        old_entries = scan(old, jobs)
+        new_entries = scan(new, jobs)
+
+        result = {
+            "old": image_info(old, old_entries),
+            "new": image_info(new, new_entries),
+            **compare(old_entries, new_entries),
+        }
+
+        if delta:
+            manifest = block_delta(old, new, Path(delta + ".bin"))
+            with Path(delta + ".json").open("w") as f:
+                json.dump(manifest, f)
+            result["delta"] = {k: v for k, v in manifest.items() if k != "ops"}
+    finally:
+        old.close()
+        new.close()
+
+    return result
+
+
+def is_squashfs(path: str) -> bool:
+    """Check whether a file is a squashfs image."""
+    try:
+        with Path(path).open("rb") as f:
+            return f.read(4) == struct.pack("<I", SQUASHFS_MAGIC)
+    except OSError:
+        return False
+
+
+def parse_args() -> object:
+    """Parse command-line arguments.
+
+    Returns:
+        object: The parsed arguments object.
+
+    """
+    parser = argparse.ArgumentParser(description="Compare the contents of two squashfs firmware images")
+    parser.add_argument("-j", "--jobs", type=int, help="Number of files hashed in parallel (default - number of CPUs)")
+    parser.add_argument("-o", "--output", help="Write the JSON to a file instead of stdout")
+    parser.add_argument("-d", "--delta", help="Also write a block-level delta to DELTA.json and DELTA.bin")
+    parser.add_argument("old_image", help="Old root.squashfs")
+    parser.add_argument("new_image", help="New root.squashfs")
+
+    return parser.parse_args()
+
+
+def main() -> None:
+    """Compare the images given on the command line."""
+    args = parse_args()
+
+    try:
+        result = diff_images(args.old_image, args.new_image, args.jobs, args.delta)
+    except (OSError, SquashfsError) as e:
+        stderr.write(f"{e}\n")
+        sys_exit(1)
+
+    if args.output:
+        with Path(args.output).open("w") as f:
+            json.dump(result, f, indent=2)
+    else:
+        json.dump(result, stdout, indent=2)
+        stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+"""Create a delta sysupgrade image between two firmware releases.
+
+The delta image holds the new contents of the partitions written by
+sysupgrade as operations against their current contents, so only the data
+that changed between the releases has to be downloaded. It is applied on the
+device with 'mtd-delta' by default_do_upgrade() or nand_do_upgrade().
+
+Two layouts are supported:
+
+--part NAME  The old and new sysupgrade images are written as a whole to MTD
+             partition NAME (e.g. 'firmware'). The partition is patched in
+             place, so blocks of the old root file system are only reused
+             where that is safe. The flash behind the old squashfs is not
+             compared, it holds the overlay by now.
+--nand       The old and new images are NAND sysupgrade tar files. The
+             'root' squashfs is patched into a new UBI volume, the kernel is
+             stored in full.
+
+Devices only accept delta images if their platform sets DELTA_UPGRADE to
+'mtd' or 'nand'. None of the targets in this tree does so far: the ipq40xx
+FIT images are flashed section by section to the failsafe partitions and
+there is no FIT mode here, so this is the infrastructure for targets using
+default_do_upgrade() or nand_do_upgrade(). Metadata of the new image is added to the delta image with
+fwtool, signing is left to the usual release step.
+"""
+from __future__ import annotations
+
+import argparse
+import hashlib
+import shutil
+import struct
+import tarfile
+import tempfile
+from pathlib import Path
+from subprocess import DEVNULL, run
+from sys import exit as sys_exit
+from sys import stderr
+
+from squashfs_diff import SQUASHFS_MAGIC, SquashfsError, SquashfsImage, delta_ops
+
+DELTA_MAGIC = b"MDLT"
+DELTA_VERSION = 1
+HEADER = struct.Struct("<4sIII")
+SECTION = struct.Struct("<32sQQ32s32sII")
+OP = struct.Struct("<IIQ")
+OP_COPY, OP_DATA = 0, 1
+
+FWTOOL_MAGIC = b"FWx0"
+SQUASHFS_PAD = 4096
+
+
+class Section:
+    """New contents of one partition or volume.
+
+    Attributes:
+        name (str): Partition name, or 'kernel' / 'root' for NAND images.
+        old (bytes): Old contents the operations refer to.
+        new (bytes): New contents.
+        ops (list[tuple[str, int, int]]): Copy (old offset) and data (new offset) operations with their length.
+
+    """
+
+    def __init__(self, name: str, old: bytes, new: bytes) -> None:
+        """Initialize a section that stores the new contents in full."""
+        self.name = name
+        self.old = old
+        self.new = new
+        self.ops = [("data", 0, len(new))] if new else []
+
+    @property
+    def copied(self) -> int:
+        """Number of bytes taken from the old contents."""
+        return sum(length for op, _, length in self.ops if op == "copy")
+
+
+def find_squashfs(path: Path) -> SquashfsImage:
+    """Find the squashfs root file system in a firmware image.
+
+    Args:
+        path (Path): The firmware image.
+
+    Returns:
+        SquashfsImage: The file system.
+
+    Raises:
+        SquashfsError: If the image holds no squashfs 4.0 file system.
+
+    """
+    data = path.read_bytes()
+    magic = struct.pack("<I", SQUASHFS_MAGIC)
+    offset = data.find(magic)
+
+    while offset >= 0:
+        try:
+            return SquashfsImage(str(path), offset)
+        except SquashfsError:
+            offset = data.find(magic, offset + 1)
+
+    raise SquashfsError(f"{path}: no squashfs file system found")
+
+
+def squashfs_ops(old: SquashfsImage, new: SquashfsImage, *, in_place: bool) -> list[tuple[str, int, int]]:
+    """Return the operations producing the image of 'new' from the image of 'old'.
+
+    Everything in front of the new file system is literal data, as is every
+    copy that would read old data already overwritten when applied in place.
+
+    Args:
+        old (SquashfsImage): The installed file system.
+        new (SquashfsImage): The new file system.
+        in_place (bool): Whether the result is written over the old image.
+
+    Returns:
+        list[tuple[str, int, int]]: Operations with image offsets.
+
+    """
+    ops = [("data", 0, new.offset)] if new.offset else []
+    pos = new.offset
+
+    for op, start, length in delta_ops(old, new):
+        if op == "copy" and not (in_place and old.offset + start < pos):
+            ops.append(("copy", old.offset + start, length))
+        elif ops and ops[-1][0] == "data":
+            ops[-1] = ("data", ops[-1][1], ops[-1][2] + length)
+        else:
+            ops.append(("data", pos, length))
+        pos += length
+
+    return ops
+
+
+def strip_trailers(path: Path, fwtool: str | None) -> None:
+    """Remove fwtool metadata and signatures from an image."""
+    with path.open("rb") as f:
+        f.seek(-16, 2)
+        if f.read(4) != FWTOOL_MAGIC:
+            return
+
+    if not fwtool:
+        raise SquashfsError(f"{path}: fwtool is needed to remove the image metadata")
+
+    for kind in ("-s", "-i"):
+        run([fwtool, "-q", "-t", kind, "/dev/null", str(path)], stderr=DEVNULL, check=False)  # noqa: S603
+
+
+def mtd_sections(old: Path, new: Path, part: str) -> list[Section]:
+    """Describe a sysupgrade image written to a single MTD partition.
+
+    Args:
+        old (Path): The installed image, without metadata.
+        new (Path): The new image, without metadata.
+        part (str): The partition name.
+
+    Returns:
+        list[Section]: The section.
+
+    """
+    old_fs = find_squashfs(old)
+    new_fs = find_squashfs(new)
+    try:
+        # Only the kernel and the squashfs are still on flash unchanged
+        used = -(-old_fs.bytes_used // SQUASHFS_PAD) * SQUASHFS_PAD
+        section = Section(part, old.read_bytes()[: old_fs.offset + used], new.read_bytes())
+        section.ops = squashfs_ops(old_fs, new_fs, in_place=True)
+    finally:
+        old_fs.close()
+        new_fs.close()
+
+    return [section]
+
+
+def tar_member(tar: tarfile.TarFile, name: str) -> bytes:
+    """Return the contents of sysupgrade-*/<name> in a sysupgrade tar file, or b""."""
+    for member in tar.getmembers():
+        if member.isfile() and member.name.startswith("sysupgrade-") and member.name.endswith("/" + name):
+            return tar.extractfile(member).read()
+    return b""
+
+
+def nand_sections(old: Path, new: Path, work_dir: Path) -> list[Section]:
+    """Describe a NAND sysupgrade tar file as kernel and root sections.
+
+    Args:
+        old (Path): The installed image.
+        new (Path): The new image.
+        work_dir (Path): Directory for the extracted root file systems.
+
+    Returns:
+        list[Section]: The sections.
+
+    Raises:
+        SquashfsError: If either image has no squashfs root.
+
+    """
+    with tarfile.open(old) as old_tar, tarfile.open(new) as new_tar:
+        old_root = work_dir / "old.root"
+        new_root = work_dir / "new.root"
+        old_root.write_bytes(tar_member(old_tar, "root"))
+        new_root.write_bytes(tar_member(new_tar, "root"))
+        kernel = tar_member(new_tar, "kernel")
+
+    old_fs = SquashfsImage(str(old_root))
+    new_fs = SquashfsImage(str(new_root))
+    try:
+        root = Section("root", old_root.read_bytes(), new_root.read_bytes())
+        root.ops = squashfs_ops(old_fs, new_fs, in_place=False)
+    finally:
+        old_fs.close()
+        new_fs.close()
+
+    return [Section("kernel", b"", kernel), root] if kernel else [root]
+
+
+def write_delta(path: Path, sections: list[Section]) -> None:
+    """Write the delta image.
+
+    Args:
+        path (Path): The delta image.
+        sections (list[Section]): The sections, applied in this order.
+
+    """
+    with path.open("wb") as f:
+        f.write(HEADER.pack(DELTA_MAGIC, DELTA_VERSION, len(sections), 0))
+
+        for s in sections:
+            f.write(
+                SECTION.pack(
+                    s.name.encode(),
+                    len(s.old),
+                    len(s.new),
+                    hashlib.sha256(s.old).digest(),
+                    hashlib.sha256(s.new).digest(),
+                    len(s.ops),
+                    0,
+                ),
+            )
+            for op, start, length in s.ops:
+                if op == "copy":
+                    f.write(OP.pack(OP_COPY, length, start))
+                else:
+                    f.write(OP.pack(OP_DATA, length, 0))
+                    f.write(s.new[start : start + length])
+
+
+def parse_args() -> object:
+    """Parse command-line arguments.
+
+    Returns:
+        object: The parsed arguments object.
+
+    """
+    parser = argparse.ArgumentParser(description="Create a delta sysupgrade image between two firmware releases")
+    layout = parser.add_mutually_exclusive_group()
+    layout.add_argument("--part", default="firmware", help="MTD partition the image is written to (default - firmware)")
+    layout.add_argument("--nand", action="store_true", help="The images are NAND sysupgrade tar files")
+    parser.add_argument("--fwtool", default=shutil.which("fwtool"), help="fwtool binary (default - from PATH)")
+    parser.add_argument("old_image", help="Sysupgrade image installed on the devices")
+    parser.add_argument("new_image", help="New sysupgrade image")
+    parser.add_argument("delta_image", help="Delta image to create")
+
+    return parser.parse_args()
+
+
+def main() -> None:
+    """Create the delta image given on the command line."""
+    args = parse_args()
+    delta = Path(args.delta_image)
+
+    try:
+        with tempfile.TemporaryDirectory() as tmp:
+            work_dir = Path(tmp)
+            old = work_dir / "old.img"
+            new = work_dir / "new.img"
+            shutil.copyfile(args.old_image, old)
+            shutil.copyfile(args.new_image, new)
+            strip_trailers(old, args.fwtool)
+            strip_trailers(new, args.fwtool)
+
+            sections = nand_sections(old, new, work_dir) if args.nand else mtd_sections(old, new, args.part)
+            write_delta(delta, sections)
+
+            if args.fwtool and run([args.fwtool, "-q", "-i", str(work_dir / "meta"), args.new_image], check=False).returncode == 0:  # noqa: S603
+                run([args.fwtool, "-I", str(work_dir / "meta"), str(delta)], check=True)  # noqa: S603
+            else:
+                stderr.write(f"Warning: no metadata added to {delta}\n")
+    except (OSError, SquashfsError, tarfile.TarError) as e:
+        stderr.write(f"{e}\n")
+        sys_exit(1)
+
+    new_size = sum(len(s.new) for s in sections)
+    copied = sum(s.copied for s in sections)
+    print(f"{delta}: {delta.stat().st_size} bytes for {new_size} bytes of new firmware, {copied} bytes reused")
+    for s in sections:
+        print(f"  {s.name}: {len(s.new)} bytes, {s.copied} reused from {len(s.old)}")
+
+
+if __name__ == "__main__":
+    main()
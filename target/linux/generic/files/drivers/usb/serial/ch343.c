@@ -98,6 +98,16 @@ static struct ch343 *ch343_table[CH343_TTY_MINORS];
 
 static DEFINE_MUTEX(ch343_minors_lock);
 
+/*
+ * Number of bulk-in URBs kept in flight per port. Each one holds a single
+ * max-packet buffer, so more of them means the host controller always has a
+ * transfer queued and incoming characters reach the tty without waiting for
+ * a completed URB to be resubmitted.
+ */
+static unsigned int rx_urbs = CH343_NR;
+module_param(rx_urbs, uint, 0444);
+MODULE_PARM_DESC(rx_urbs, "Number of in-flight bulk-in URBs per port (1-16)");
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0))
 static void ch343_tty_set_termios(struct tty_struct *tty,
 				  const struct ktermios *termios_old);
@@ -1938,7 +1948,7 @@ static int ch343_probe(struct usb_interface *intf,
 	int ctrlsize, readsize;
 	u8 *buf;
 	unsigned long quirks;
-	int num_rx_buf = CH343_NR;
+	int num_rx_buf = clamp_t(unsigned int, rx_urbs, 1, CH343_NR_MAX);
 	int i;
 	unsigned int elength = 0;
 	struct device *tty_dev;
@@ -93,6 +93,7 @@
 
 #define CH343_NW 2
 #define CH343_NR 2
+#define CH343_NR_MAX 16
 
 #define IOID 0x13572468
 
@@ -169,8 +170,8 @@ struct ch343 {
 	dma_addr_t ctrl_dma; /* dma handles of buffers */
 	struct ch343_wb wb[CH343_NW];
 	unsigned long read_urbs_free;
-	struct urb *read_urbs[CH343_NR];
-	struct ch343_rb read_buffers[CH343_NR];
+	struct urb *read_urbs[CH343_NR_MAX];
+	struct ch343_rb read_buffers[CH343_NR_MAX];
 	int rx_buflimit;
 	int rx_endpoint;
 	spinlock_t read_lock;